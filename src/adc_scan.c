@@ -0,0 +1,266 @@
+#include "adc_scan.h"
+
+#include <stdlib.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "buffer_pool.h"
+#include "trace_points.h"
+
+LOG_MODULE_REGISTER(adc_scan, LOG_LEVEL_DBG);
+
+// The battery channel options define the sequence shared by all the channels
+#define BATTERY_NODE DT_NODELABEL(xiao_ble_battery_dev)
+
+#define ADC_SCAN_TOTAL_SAMPLES DT_PROP(BATTERY_NODE, adc_total_samples)
+#define ADC_SCAN_SAMPLE_INTERVAL_US DT_PROP(BATTERY_NODE, adc_sample_interval)
+#define ADC_SCAN_RESOLUTION DT_PROP(BATTERY_NODE, adc_resolution)
+#define ADC_SCAN_OVERSAMPLING DT_PROP(BATTERY_NODE, adc_oversampling)
+#define ADC_SCAN_CALIBRATION_INTERVAL_MS (DT_PROP(BATTERY_NODE, adc_calibration_interval) * MSEC_PER_SEC)
+#define ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA DT_PROP(BATTERY_NODE, adc_calibration_temperature_delta)
+#define ADC_SCAN_CHANNELS_MAX 8
+// The die temperature fetch blocks on the TEMP peripheral, so the drift is checked at most this often
+#define ADC_SCAN_TEMPERATURE_CHECK_INTERVAL_MS 60000
+
+#if ADC_SCAN_OVERSAMPLING
+// The SAADC averages the oversampled conversions, every channel gets a single sample per scan
+#define ADC_SCAN_CHANNEL_SAMPLES 1
+#else
+#define ADC_SCAN_CHANNEL_SAMPLES ADC_SCAN_TOTAL_SAMPLES
+#endif
+
+struct scan_channel {
+    uint8_t id;
+    adc_scan_callback_t callback;
+    void *user_data;
+};
+
+static const struct device *adc_dev = DEVICE_DT_GET(DT_NODELABEL(adc));
+
+static struct scan_channel channels[ADC_SCAN_CHANNELS_MAX];
+static size_t channels_count = 0;
+
+#define ADC_SCAN_BUFFER_SAMPLES (ADC_SCAN_CHANNEL_SAMPLES * ADC_SCAN_CHANNELS_MAX)
+// An oversampled scan (int16_t samples) fits a buffer pool block, the multi-sample sequences keep their own buffer
+#define ADC_SCAN_POOLED_BUFFER (ADC_SCAN_BUFFER_SAMPLES * 2 <= BUFFER_POOL_BLOCK_SIZE)
+
+// Samples of all the channels, interleaved in the ascending channel id order for every sampling
+#if ADC_SCAN_POOLED_BUFFER
+static int16_t *scan_buffer = NULL;
+#else
+static int16_t scan_buffer_storage[ADC_SCAN_BUFFER_SAMPLES];
+static int16_t *scan_buffer = scan_buffer_storage;
+#endif
+
+#if !ADC_SCAN_OVERSAMPLING
+static struct adc_sequence_options options = {
+    .extra_samplings = ADC_SCAN_TOTAL_SAMPLES - 1,
+    .interval_us = ADC_SCAN_SAMPLE_INTERVAL_US,
+};
+#endif
+
+static struct adc_sequence sequence = {
+    .options = COND_CODE_0(ADC_SCAN_OVERSAMPLING, (&options), (NULL)),
+    .channels = 0,
+    .buffer = NULL,
+    .buffer_size = 0,
+    .resolution = ADC_SCAN_RESOLUTION,
+    .oversampling = ADC_SCAN_OVERSAMPLING,
+};
+
+#if ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA
+static const struct device *temp_dev = DEVICE_DT_GET(DT_NODELABEL(temp));
+#endif
+
+static bool is_calibrated = false;
+static int64_t calibrated_at_ms;
+static int32_t calibrated_temperature;
+static int64_t temperature_checked_at_ms;
+
+static K_MUTEX_DEFINE(adc_scan_mut);
+
+int adc_scan_add_channel(const struct adc_channel_cfg *cfg, adc_scan_callback_t callback, void *user_data)
+{
+    int err;
+
+    if (!device_is_ready(adc_dev)) {
+        LOG_ERR("ADC device not found!");
+        return -EIO;
+    }
+
+    k_mutex_lock(&adc_scan_mut, K_FOREVER);
+
+    if (channels_count == ADC_SCAN_CHANNELS_MAX) {
+        LOG_ERR("Maximum number of channels reached, operation aborted");
+        err = -ENOMEM;
+        goto unlock;
+    }
+
+    if (sequence.channels & BIT(cfg->channel_id)) {
+        LOG_ERR("ADC channel %u is already in use", cfg->channel_id);
+        err = -EALREADY;
+        goto unlock;
+    }
+
+    err = adc_channel_setup(adc_dev, cfg);
+    if (err) {
+        LOG_ERR("ADC channel %u setup failed (error %d)", cfg->channel_id, err);
+        goto unlock;
+    }
+
+    channels[channels_count++] = (struct scan_channel){
+        .id = cfg->channel_id,
+        .callback = callback,
+        .user_data = user_data,
+    };
+    sequence.channels |= BIT(cfg->channel_id);
+    sequence.buffer_size = sizeof(int16_t) * ADC_SCAN_CHANNEL_SAMPLES * channels_count;
+
+unlock:
+    k_mutex_unlock(&adc_scan_mut);
+    return err;
+}
+
+static int die_temperature_get(int32_t *temperature)
+{
+#if ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA
+    struct sensor_value value;
+    int err;
+
+    if (!device_is_ready(temp_dev)) {
+        return -ENODEV;
+    }
+
+    err = sensor_sample_fetch(temp_dev);
+    if (!err) {
+        err = sensor_channel_get(temp_dev, SENSOR_CHAN_DIE_TEMP, &value);
+    }
+    if (!err) {
+        *temperature = value.val1;
+    }
+
+    return err;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+// The offset is calibrated on the first scan, then once the interval elapses or the die temperature drifts
+static bool is_calibration_due(int64_t now_ms, int32_t *temperature)
+{
+    bool is_due = !is_calibrated;
+
+    if (!ADC_SCAN_CALIBRATION_INTERVAL_MS && !ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA) {
+        return false;
+    }
+
+    if (ADC_SCAN_CALIBRATION_INTERVAL_MS && now_ms - calibrated_at_ms >= ADC_SCAN_CALIBRATION_INTERVAL_MS) {
+        is_due = true;
+    }
+
+    // A calibration due anyway fetches the temperature too, it becomes the new reference
+    if (ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA &&
+        (is_due || now_ms - temperature_checked_at_ms >= ADC_SCAN_TEMPERATURE_CHECK_INTERVAL_MS)) {
+        temperature_checked_at_ms = now_ms;
+        if (!die_temperature_get(temperature) &&
+            abs(*temperature - calibrated_temperature) >= ADC_SCAN_CALIBRATION_TEMPERATURE_DELTA) {
+            is_due = true;
+        }
+    }
+
+    return is_due;
+}
+
+static int scan(bool calibrate)
+{
+#if ADC_SCAN_OVERSAMPLING
+    /*
+     * The SAADC driver only oversamples a sequence with a single channel, so instead of one multi-channel
+     * scan every channel gets its own back to back read. The channels are then converted a few tens of
+     * microseconds apart, instead of within the same scan.
+     */
+    for (size_t i = 0; i < channels_count; i++) {
+        size_t index = __builtin_popcount(sequence.channels & (BIT(channels[i].id) - 1));
+        struct adc_sequence channel_sequence = sequence;
+
+        channel_sequence.channels = BIT(channels[i].id);
+        channel_sequence.buffer = &scan_buffer[index];
+        channel_sequence.buffer_size = sizeof(int16_t);
+        channel_sequence.calibrate = calibrate && i == 0;
+
+        int err = adc_read(adc_dev, &channel_sequence);
+        if (err) {
+            return err;
+        }
+    }
+
+    return 0;
+#else
+    sequence.buffer = scan_buffer;
+    sequence.calibrate = calibrate;
+    return adc_read(adc_dev, &sequence);
+#endif
+}
+
+int adc_scan_read(void)
+{
+    int64_t now_ms = k_uptime_get();
+    int32_t temperature = calibrated_temperature;
+    bool calibrate;
+    int err;
+
+    k_mutex_lock(&adc_scan_mut, K_FOREVER);
+
+    if (channels_count == 0) {
+        err = -ENODEV;
+        goto unlock;
+    }
+
+#if ADC_SCAN_POOLED_BUFFER
+    scan_buffer = buffer_pool_alloc(BUFFER_POOL_USER_ADC_SCAN);
+    if (scan_buffer == NULL) {
+        err = -ENOMEM;
+        goto unlock;
+    }
+#endif
+
+    calibrate = is_calibration_due(now_ms, &temperature);
+
+    TRACE_POINT("adc_scan_begin", channels_count, calibrate);
+    err = scan(calibrate);
+    TRACE_POINT("adc_scan_end", err, 0);
+    if (err) {
+        LOG_WRN("ADC read failed (error %d)", err);
+        goto unlock;
+    }
+
+    if (calibrate) {
+        LOG_DBG("ADC offset calibrated at %d C", temperature);
+        is_calibrated = true;
+        calibrated_at_ms = now_ms;
+        calibrated_temperature = temperature;
+    }
+
+    for (size_t i = 0; i < channels_count; i++) {
+        size_t index = __builtin_popcount(sequence.channels & (BIT(channels[i].id) - 1));
+        channels[i].callback(&scan_buffer[index], ADC_SCAN_CHANNEL_SAMPLES, channels_count, channels[i].user_data);
+    }
+
+unlock:
+#if ADC_SCAN_POOLED_BUFFER
+    if (scan_buffer) {
+        buffer_pool_free(BUFFER_POOL_USER_ADC_SCAN, scan_buffer);
+        scan_buffer = NULL;
+    }
+#endif
+    k_mutex_unlock(&adc_scan_mut);
+    return err;
+}
+
+int adc_scan_raw_to_millivolts(enum adc_gain gain, int32_t *value)
+{
+    return adc_raw_to_millivolts(adc_ref_internal(adc_dev), gain, ADC_SCAN_RESOLUTION, value);
+}
@@ -0,0 +1,39 @@
+#ifndef __ADC_SCAN_H__
+#define __ADC_SCAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/drivers/adc.h>
+
+/**
+ * @brief Callback executed for every channel when a scan is done.
+ *
+ * @param[in] samples First sample of the channel. The following ones are `stride` samples apart.
+ * @param[in] count Number of the channel samples.
+ * @param[in] stride Distance between the channel samples in the scan buffer.
+ * @param[in] user_data User data passed to adc_scan_add_channel.
+ */
+typedef void (*adc_scan_callback_t)(const int16_t *samples, size_t count, size_t stride, void *user_data);
+
+/**
+ * @brief Add the channel to the SAADC scan sequence.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int adc_scan_add_channel(const struct adc_channel_cfg *cfg, adc_scan_callback_t callback, void *user_data);
+
+/**
+ * @brief Run a single conversion of all the channels and pass the samples to their callbacks.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int adc_scan_read(void);
+
+/**
+ * @brief Convert the raw channel value to millivolts.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int adc_scan_raw_to_millivolts(enum adc_gain gain, int32_t *value);
+
+#endif  //__ADC_SCAN_H__
@@ -0,0 +1,406 @@
+#include "advertising.h"
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+LOG_MODULE_REGISTER(advertising, LOG_LEVEL_DBG);
+
+enum adv_stage_type {
+    // High duty cycle directed advertising to the last bonded central, the controller stops it after 1.28 s
+    ADV_STAGE_DIRECTED,
+    // Undirected advertising, only the bonded centrals are allowed to connect
+    ADV_STAGE_ACCEPT_LIST,
+    // Undirected advertising, anybody is allowed to connect
+    ADV_STAGE_UNDIRECTED,
+};
+
+struct adv_stage {
+    enum adv_stage_type type;
+    uint16_t interval_min;
+    uint16_t interval_max;
+    // Time before moving on to the next stage, 0 keeps the stage until a connection (or the directed timeout)
+    uint16_t duration_sec;
+};
+
+/*
+ * Advertising schedule, restarted from the first stage on boot and after every disconnection.
+ * The stages which need a bonded central are skipped when there is none.
+ *
+ * The schedule is changed from the connection callbacks, the system workqueue and the motion callback,
+ * stage_mut serializes all of them.
+ */
+static const struct adv_stage stages[] = {
+    {ADV_STAGE_DIRECTED, 0, 0, 0},
+    {ADV_STAGE_ACCEPT_LIST, BT_GAP_ADV_FAST_INT_MIN_1, BT_GAP_ADV_FAST_INT_MAX_1, 5},
+    {ADV_STAGE_ACCEPT_LIST, BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, 25},
+    {ADV_STAGE_UNDIRECTED, BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, 30},
+    {ADV_STAGE_UNDIRECTED, BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, 0},
+};
+
+// ESS service data: temperature (sint16, 0.01 DegC), humidity (uint16, 0.01 %RH), pressure (sint16, hPa)
+static uint8_t ess_data[] = {BT_UUID_16_ENCODE(BT_UUID_ESS_VAL), 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+// BAS service data: battery level (uint8, %)
+static uint8_t bas_data[] = {BT_UUID_16_ENCODE(BT_UUID_BAS_VAL), 0x00};
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA_BYTES(BT_DATA_UUID16_ALL, BT_UUID_16_ENCODE(BT_UUID_BAS_VAL), BT_UUID_16_ENCODE(BT_UUID_ESS_VAL),
+                  BT_UUID_16_ENCODE(BT_UUID_AIOS_VAL)),
+    BT_DATA(BT_DATA_SVC_DATA16, ess_data, sizeof(ess_data)),
+    BT_DATA(BT_DATA_SVC_DATA16, bas_data, sizeof(bas_data)),
+};
+
+static const struct bt_data sd[] = {
+    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
+};
+
+#define STAGE_NONE SIZE_MAX
+
+static void next_stage(struct k_work *work);
+static void save_last_peer(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(next_stage_work, next_stage);
+static K_WORK_DEFINE(save_last_peer_work, save_last_peer);
+static K_MUTEX_DEFINE(stage_mut);
+
+static bool restart_advertisement = false;
+static atomic_t is_advertising = ATOMIC_INIT(0);
+static size_t stage = 0;
+// Stage the next_stage_work moves to, STAGE_NONE when the schedule was restarted in the meantime
+static size_t scheduled_stage = STAGE_NONE;
+// The final stage keeps the fast interval, e.g. while the device is being carried around
+static bool fast_interval = false;
+// Last bonded central, the target of the directed advertising, persisted across the reboots
+static bt_addr_le_t last_peer;
+static bool has_last_peer = false;
+
+static void update_advertising_data(void)
+{
+    if (!atomic_get(&is_advertising)) {
+        return;
+    }
+
+    int err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+    if (err) {
+        LOG_DBG("Advertising data update failed (err %d)", err);
+    }
+}
+
+static void accept_list_add_bond(const struct bt_bond_info *info, void *user_data)
+{
+    size_t *count = user_data;
+
+    int err = bt_le_filter_accept_list_add(&info->addr);
+    if (err) {
+        LOG_WRN("Failed to add a bond to the accept list (err %d)", err);
+        return;
+    }
+    (*count)++;
+}
+
+static size_t accept_list_update(void)
+{
+    size_t count = 0;
+
+    int err = bt_le_filter_accept_list_clear();
+    if (err) {
+        LOG_WRN("Failed to clear the accept list (err %d)", err);
+        return 0;
+    }
+
+    bt_foreach_bond(BT_ID_DEFAULT, accept_list_add_bond, &count);
+    return count;
+}
+
+static void copy_first_bond(const struct bt_bond_info *info, void *user_data)
+{
+    if (!has_last_peer) {
+        bt_addr_le_copy(&last_peer, &info->addr);
+        has_last_peer = true;
+    }
+}
+
+static bool directed_peer_available(void)
+{
+    // The central may have been unpaired since it was stored
+    if (has_last_peer && !bt_addr_le_is_bonded(BT_ID_DEFAULT, &last_peer)) {
+        has_last_peer = false;
+    }
+    // None disconnected since it bonded, e.g. after an update from a firmware not storing it, target any bonded one
+    if (!has_last_peer) {
+        bt_foreach_bond(BT_ID_DEFAULT, copy_first_bond, NULL);
+    }
+
+    return has_last_peer;
+}
+
+static int start_directed(void)
+{
+    // A central using the privacy only answers to its resolvable address, the controller generates it from the IRK
+    struct bt_le_adv_param param = *BT_LE_ADV_CONN_DIR(&last_peer);
+    param.options |= BT_LE_ADV_OPT_DIR_ADDR_RPA;
+
+    // Directed advertising carries no data
+    int err = bt_le_adv_start(&param, NULL, 0, NULL, 0);
+    if (err == -EINVAL || err == -ENOTSUP) {
+        // The controller can not resolve the addresses, target the identity address
+        err = bt_le_adv_start(BT_LE_ADV_CONN_DIR(&last_peer), NULL, 0, NULL, 0);
+    }
+
+    return err;
+}
+
+// Must be called with stage_mut held
+static int start_stage(void)
+{
+    struct bt_le_adv_param param;
+    int err;
+
+    atomic_set(&is_advertising, false);
+
+    err = bt_le_adv_stop();
+    if (err) {
+        return err;
+    }
+
+    // Skip the stages without a bonded central to target, the last one is always undirected
+    while (stage < ARRAY_SIZE(stages) - 1) {
+        if (stages[stage].type == ADV_STAGE_DIRECTED && directed_peer_available()) {
+            break;
+        } else if (stages[stage].type == ADV_STAGE_ACCEPT_LIST && accept_list_update() > 0) {
+            break;
+        } else if (stages[stage].type == ADV_STAGE_UNDIRECTED) {
+            break;
+        }
+        stage++;
+    }
+
+    const struct adv_stage *current = &stages[stage];
+
+    switch (current->type) {
+    case ADV_STAGE_DIRECTED:
+        err = start_directed();
+        break;
+    case ADV_STAGE_ACCEPT_LIST:
+        param = (struct bt_le_adv_param)BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_FILTER_CONN,
+                                                             current->interval_min, current->interval_max, NULL);
+        err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+        break;
+    default:
+        if (stage == ARRAY_SIZE(stages) - 1 && fast_interval) {
+            param = (struct bt_le_adv_param)BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONN, BT_GAP_ADV_FAST_INT_MIN_2,
+                                                                 BT_GAP_ADV_FAST_INT_MAX_2, NULL);
+        } else {
+            param = (struct bt_le_adv_param)BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONN, current->interval_min,
+                                                                 current->interval_max, NULL);
+        }
+        err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+        break;
+    }
+    if (err) {
+        return err;
+    }
+
+    atomic_set(&is_advertising, current->type != ADV_STAGE_DIRECTED);
+    if (current->duration_sec) {
+        scheduled_stage = stage + 1;
+        k_work_schedule(&next_stage_work, K_SECONDS(current->duration_sec));
+    }
+
+    LOG_INF("Advertising stage %zu started", stage);
+    return 0;
+}
+
+static void next_stage(struct k_work *work)
+{
+    k_mutex_lock(&stage_mut, K_FOREVER);
+
+    // Stale run, the schedule was restarted (and possibly rescheduled) while the work was waiting for the mutex
+    if (scheduled_stage == STAGE_NONE || k_work_delayable_is_pending(&next_stage_work)) {
+        k_mutex_unlock(&stage_mut);
+        return;
+    }
+
+    stage = MIN(scheduled_stage, ARRAY_SIZE(stages) - 1);
+    scheduled_stage = STAGE_NONE;
+
+    int err = start_stage();
+    if (err) {
+        LOG_ERR("Advertising stage %zu failed to start (err %d)", stage, err);
+    }
+
+    k_mutex_unlock(&stage_mut);
+}
+
+static void save_last_peer(struct k_work *work)
+{
+    bt_addr_le_t peer;
+
+    k_mutex_lock(&stage_mut, K_FOREVER);
+    bt_addr_le_copy(&peer, &last_peer);
+    k_mutex_unlock(&stage_mut);
+
+    int err = settings_save_one("adv/peer", &peer, sizeof(peer));
+    if (err) {
+        LOG_WRN("Failed to store the last peer (err %d)", err);
+    }
+}
+
+// Must be called with stage_mut held
+static int start_schedule(size_t first_stage)
+{
+    k_work_cancel_delayable(&next_stage_work);
+    scheduled_stage = STAGE_NONE;
+    stage = first_stage;
+
+    return start_stage();
+}
+
+int advertising_start(void)
+{
+    k_mutex_lock(&stage_mut, K_FOREVER);
+    int err = start_schedule(0);
+    k_mutex_unlock(&stage_mut);
+
+    return err;
+}
+
+void advertising_set_fast_interval(bool fast)
+{
+    k_mutex_lock(&stage_mut, K_FOREVER);
+
+    // The earlier stages have their own intervals, only the final one is restarted
+    if (fast_interval != fast) {
+        fast_interval = fast;
+        if (atomic_get(&is_advertising) && stage == ARRAY_SIZE(stages) - 1) {
+            int err = start_stage();
+            if (err) {
+                LOG_ERR("Advertising stage %zu failed to restart (err %d)", stage, err);
+            }
+        }
+    }
+
+    k_mutex_unlock(&stage_mut);
+}
+
+void advertising_update_environment(int16_t temperature, uint16_t humidity, int16_t pressure)
+{
+    sys_put_le16(temperature, &ess_data[2]);
+    sys_put_le16(humidity, &ess_data[4]);
+    sys_put_le16(pressure, &ess_data[6]);
+
+    update_advertising_data();
+}
+
+void advertising_update_battery_level(uint8_t level)
+{
+    bas_data[2] = level;
+
+    update_advertising_data();
+}
+
+static void count_connection(struct bt_conn *conn, void *user_data)
+{
+    size_t *count = user_data;
+
+    (*count)++;
+}
+
+static void advertising_connected(struct bt_conn *conn, uint8_t err)
+{
+    size_t count = 0;
+
+    k_mutex_lock(&stage_mut, K_FOREVER);
+
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        // The directed advertising ended without a connection, move on to the next stage
+        scheduled_stage = stage + 1;
+        k_work_reschedule(&next_stage_work, K_NO_WAIT);
+    } else {
+        k_work_cancel_delayable(&next_stage_work);
+        scheduled_stage = STAGE_NONE;
+    }
+
+    if (!err) {
+        atomic_set(&is_advertising, false);
+
+        // The controller stops advertising on a connection, resume it while more centrals can connect.
+        // The directed stage is skipped, its central is the one most likely connected already.
+        bt_conn_foreach(BT_CONN_TYPE_LE, count_connection, &count);
+        if (count < CONFIG_BT_MAX_CONN) {
+            int ret = start_schedule(1);
+            if (ret) {
+                LOG_ERR("Advertising failed to resume (err %d)", ret);
+            }
+        }
+    }
+
+    k_mutex_unlock(&stage_mut);
+}
+
+static void advertising_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    const bt_addr_le_t *dst = bt_conn_get_dst(conn);
+
+    if (bt_addr_le_is_bonded(BT_ID_DEFAULT, dst)) {
+        k_mutex_lock(&stage_mut, K_FOREVER);
+        bool changed = !has_last_peer || !bt_addr_le_eq(&last_peer, dst);
+        bt_addr_le_copy(&last_peer, dst);
+        has_last_peer = true;
+        k_mutex_unlock(&stage_mut);
+
+        // Not from the Bluetooth RX thread, the flash write may take a while
+        if (changed) {
+            k_work_submit(&save_last_peer_work);
+        }
+    }
+
+    restart_advertisement = true;
+}
+
+static void advertising_recycled(void)
+{
+    if (!restart_advertisement) {
+        return;
+    }
+    restart_advertisement = false;
+
+    int err = advertising_start();
+    if (err) {
+        LOG_ERR("Advertising failed to restart (err %d)", err);
+        return;
+    }
+
+    LOG_INF("Advertising successfully restarted");
+}
+
+BT_CONN_CB_DEFINE(advertising_conn_callbacks) = {
+    .connected = advertising_connected,
+    .disconnected = advertising_disconnected,
+    .recycled = advertising_recycled,
+};
+
+static int adv_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    if (!settings_name_steq(name, "peer", NULL) || len != sizeof(last_peer)) {
+        return -ENOENT;
+    }
+
+    int rc = read_cb(cb_arg, &last_peer, sizeof(last_peer));
+    if (rc < 0) {
+        return rc;
+    }
+    has_last_peer = true;
+
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(adv, "adv", NULL, adv_settings_set, NULL, NULL);
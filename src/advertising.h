@@ -0,0 +1,35 @@
+#ifndef __ADVERTISING_H__
+#define __ADVERTISING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Start the connectable advertising schedule: directed to the last bonded central, then
+ * restricted to the bonded centrals, then open to anybody at a slowing down rate.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ *
+ * @note Advertising restarts by itself once a connection is recycled, and resumes after a connection while
+ * fewer than CONFIG_BT_MAX_CONN centrals are connected.
+ */
+int advertising_start(void);
+
+/**
+ * @brief Keep the fast interval in the final advertising stage instead of slowing down.
+ *
+ * The final stage restarts with the new interval when it is already running.
+ */
+void advertising_set_fast_interval(bool fast);
+
+/**
+ * @brief Update the environmental values carried in the ESS service data.
+ */
+void advertising_update_environment(int16_t temperature, uint16_t humidity, int16_t pressure);
+
+/**
+ * @brief Update the battery level carried in the BAS service data.
+ */
+void advertising_update_battery_level(uint8_t level);
+
+#endif  //__ADVERTISING_H__
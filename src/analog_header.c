@@ -0,0 +1,117 @@
+#include "analog_header.h"
+
+#include <stdlib.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "adc_scan.h"
+
+LOG_MODULE_REGISTER(analog_header, LOG_LEVEL_DBG);
+
+#if !DT_NODE_EXISTS(DT_NODELABEL(xiao_analog_header))
+#error "Overlay for xiao_analog_header node not properly defined."
+#endif
+
+#define ANALOG_HEADER_NODE DT_NODELABEL(xiao_analog_header)
+
+// Filtered values keep 4 fractional bits
+#define FILTER_FRACTION_BITS 4
+
+struct analog_channel {
+    struct adc_channel_cfg cfg;
+    uint8_t filter_shift;
+    uint16_t notify_threshold;
+    int32_t filtered;
+    uint16_t millivolt;
+    uint16_t notified_millivolt;
+    bool is_sampled;
+};
+
+#define ANALOG_CHANNEL_INIT(node)                                                                      \
+    {                                                                                                  \
+        .cfg =                                                                                         \
+            {                                                                                          \
+                .gain = ADC_GAIN_1_6,                                                                  \
+                .reference = ADC_REF_INTERNAL,                                                         \
+                .acquisition_time = ADC_ACQ_TIME_DEFAULT,                                              \
+                .channel_id = DT_PROP(node, adc_channel_id),                                           \
+                IF_ENABLED(CONFIG_ADC_NRFX_SAADC, (.input_positive = DT_PROP(node, adc_channel), )) \
+            },                                                                                         \
+        .filter_shift = DT_PROP(node, filter_shift),                                                   \
+        .notify_threshold = DT_PROP(node, notify_threshold),                                           \
+    },
+
+static struct analog_channel channels[] = {DT_FOREACH_CHILD(ANALOG_HEADER_NODE, ANALOG_CHANNEL_INIT)};
+
+#define CHANNELS_COUNT ARRAY_SIZE(channels)
+
+static analog_header_callback_t channel_callback = NULL;
+
+static void channel_samples_ready(const int16_t *samples, size_t count, size_t stride, void *user_data)
+{
+    struct analog_channel *channel = user_data;
+    uint8_t index = channel - channels;
+    int32_t sum = 0;
+
+    for (size_t sample = 0; sample < count; sample++) {
+        sum += samples[sample * stride];
+    }
+
+    int32_t millivolt = sum / (int32_t)count;
+    if (adc_scan_raw_to_millivolts(channel->cfg.gain, &millivolt)) {
+        return;
+    }
+    millivolt = CLAMP(millivolt, 0, UINT16_MAX);
+
+    // The first sample primes the filter, the next ones are blended in
+    if (!channel->is_sampled) {
+        channel->filtered = millivolt << FILTER_FRACTION_BITS;
+    } else {
+        channel->filtered += ((millivolt << FILTER_FRACTION_BITS) - channel->filtered) >> channel->filter_shift;
+    }
+    channel->millivolt = channel->filtered >> FILTER_FRACTION_BITS;
+
+    if (channel->is_sampled && abs(channel->millivolt - channel->notified_millivolt) < channel->notify_threshold) {
+        return;
+    }
+    channel->is_sampled = true;
+    channel->notified_millivolt = channel->millivolt;
+
+    LOG_DBG("A%u is at %u mV", index, channel->millivolt);
+
+    if (channel_callback) {
+        channel_callback(index, channel->millivolt);
+    }
+}
+
+uint8_t analog_header_channels_count(void)
+{
+    return CHANNELS_COUNT;
+}
+
+uint16_t analog_header_get_millivolt(uint8_t channel)
+{
+    return channel < CHANNELS_COUNT ? channels[channel].millivolt : 0;
+}
+
+void analog_header_register_callback(analog_header_callback_t callback)
+{
+    channel_callback = callback;
+}
+
+int analog_header_init(void)
+{
+    int err;
+
+    for (size_t i = 0; i < CHANNELS_COUNT; i++) {
+        err = adc_scan_add_channel(&channels[i].cfg, channel_samples_ready, &channels[i]);
+        if (err) {
+            LOG_ERR("A%zu channel setup failed (err %d)", i, err);
+            return err;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef __ANALOG_HEADER_H__
+#define __ANALOG_HEADER_H__
+
+#include <stdint.h>
+
+typedef void (*analog_header_callback_t)(uint8_t channel, uint16_t millivolt);
+
+/**
+ * @brief Get the number of the analog header channels.
+ */
+uint8_t analog_header_channels_count(void);
+
+/**
+ * @brief Get the last filtered value of the channel in millivolts.
+ */
+uint16_t analog_header_get_millivolt(uint8_t channel);
+
+/**
+ * @brief Register a callback function that is executed every time the filtered value of a channel
+ * moves by at least its notify threshold.
+ */
+void analog_header_register_callback(analog_header_callback_t callback);
+
+/**
+ * @brief Add the analog header channels to the SAADC scan sequence.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ *
+ * @note The channels are converted together with the battery channel on each of its samples.
+ */
+int analog_header_init(void);
+
+#endif  //__ANALOG_HEADER_H__
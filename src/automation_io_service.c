@@ -3,85 +3,473 @@
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 
-LOG_MODULE_REGISTER(automation_io_service, LOG_LEVEL_INF);
+#include "analog_header.h"
+#include "gatt_stats.h"
+#include "gpio_header.h"
+#include "notification_dispatcher.h"
+#include "trace_points.h"
 
-static const uint8_t NUM_OF_DIGITALS[] = {3};
+LOG_MODULE_REGISTER(automation_io_service, LOG_LEVEL_DBG);
 
-static const struct gpio_dt_spec led0 = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
-static const struct gpio_dt_spec led1 = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios);
-static const struct gpio_dt_spec led2 = GPIO_DT_SPEC_GET(DT_ALIAS(led2), gpios);
+#define LEDS_COUNT 3
 
+// Pattern characteristic layout: repeat count followed by (state, little-endian duration) steps
+#define LED_PATTERN_HEADER_SIZE 1
+#define LED_PATTERN_STEP_SIZE 3
+#define LED_PATTERN_SIZE_MAX (LED_PATTERN_HEADER_SIZE + LED_PATTERN_STEP_SIZE * LED_PATTERN_STEPS_MAX)
+
+// The Digital characteristic holds 2 bits per digital, only the lower "active" bit drives the LED
+#define DIGITAL_IS_ACTIVE(state, index) (((state) >> ((index) * 2)) & 0x01)
+#define DIGITAL_INACTIVE 0x00
+#define DIGITAL_ACTIVE 0x01
+#define DIGITAL_UNKNOWN 0x03
+
+#define HEADER_PINS_COUNT DT_CHILD_NUM(DT_NODELABEL(xiao_gpio_header))
+#define HEADER_DIGITAL_SIZE DIV_ROUND_UP(HEADER_PINS_COUNT * 2, 8)
+// Header configuration layout: little-endian debounce period followed by the pin modes
+#define HEADER_CONFIG_SIZE (2 + HEADER_PINS_COUNT)
+// Header event layout: timestamp (uint32), changed pins (uint16), pin levels (uint16), edges (uint16)
+#define HEADER_EVENT_SIZE 10
+
+#define ANALOG_HEADER_NODE DT_NODELABEL(xiao_analog_header)
+#define ANALOG_CHANNELS_COUNT DT_CHILD_NUM(ANALOG_HEADER_NODE)
+
+static const uint8_t NUM_OF_DIGITALS[] = {LEDS_COUNT};
+static const uint8_t NUM_OF_HEADER_DIGITALS[] = {HEADER_PINS_COUNT};
+
+static const struct gpio_dt_spec leds[LEDS_COUNT] = {
+    GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(led2), gpios),
+};
+
+static gpio_port_pins_t leds_mask = 0;
 static volatile uint8_t leds_state = 0x00;
 
-static void update_led_state(const struct gpio_dt_spec *led, uint8_t index, bool is_on)
+static struct k_timer pattern_timer;
+static struct k_spinlock pattern_lock;
+static struct led_pattern pattern;
+static uint8_t pattern_step;
+static uint8_t pattern_repeats_left;
+
+static uint8_t header_event[HEADER_EVENT_SIZE];
+static const struct bt_gatt_attr *header_event_attr;
+
+static const struct bt_gatt_attr *analog_attrs[ANALOG_CHANNELS_COUNT];
+
+static const struct bt_gatt_cpf analog_att_format_cpf = {
+    .format = 0x06, /* uint16 */
+    .exponent = -3,
+    .unit = 0x2728,        /* Volt */
+    .name_space = 0x01,    /* Bluetooth SIG */
+    .description = 0x0000, /* "unknown" */
+};
+
+static void update_leds_state(uint8_t state)
+{
+    gpio_port_value_t value = 0;
+
+    for (size_t i = 0; i < LEDS_COUNT; i++) {
+        if (DIGITAL_IS_ACTIVE(state, i)) {
+            value |= BIT(leds[i].pin);
+        }
+    }
+
+    // All the LEDs share the same port, so they change together with a single write
+    gpio_port_set_masked(leds[0].port, leds_mask, value);
+    leds_state = state;
+}
+
+static void pattern_timer_expired(struct k_timer *timer)
+{
+    k_spinlock_key_t key = k_spin_lock(&pattern_lock);
+
+    if (pattern.steps_count == 0) {
+        goto unlock;
+    }
+
+    if (++pattern_step >= pattern.steps_count) {
+        pattern_step = 0;
+        if (pattern.repeat != 0 && --pattern_repeats_left == 0) {
+            pattern.steps_count = 0;
+            goto unlock;
+        }
+    }
+
+    TRACE_POINT("aios_pattern_step", pattern_step, pattern.steps[pattern_step].state);
+    update_leds_state(pattern.steps[pattern_step].state);
+    k_timer_start(&pattern_timer, K_MSEC(pattern.steps[pattern_step].duration_ms), K_NO_WAIT);
+
+unlock:
+    k_spin_unlock(&pattern_lock, key);
+}
+
+int automation_io_service_play_pattern(const struct led_pattern *new_pattern)
+{
+    if (new_pattern->steps_count == 0 || new_pattern->steps_count > LED_PATTERN_STEPS_MAX) {
+        return -EINVAL;
+    }
+
+    for (uint8_t i = 0; i < new_pattern->steps_count; i++) {
+        if (new_pattern->steps[i].duration_ms == 0) {
+            return -EINVAL;
+        }
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&pattern_lock);
+
+    pattern = *new_pattern;
+    pattern_step = 0;
+    pattern_repeats_left = pattern.repeat;
+    update_leds_state(pattern.steps[0].state);
+    k_timer_start(&pattern_timer, K_MSEC(pattern.steps[0].duration_ms), K_NO_WAIT);
+
+    k_spin_unlock(&pattern_lock, key);
+
+    LOG_DBG("LED pattern of %u steps started (repeat %u)", new_pattern->steps_count, new_pattern->repeat);
+
+    return 0;
+}
+
+void automation_io_service_stop_pattern(void)
 {
-    int val = is_on > 0 ? 1 : 0;
-    gpio_pin_set_dt(led, val);
-    LOG_INF("LED%i is %s", index, is_on ? "On" : "Off");
+    k_timer_stop(&pattern_timer);
+
+    k_spinlock_key_t key = k_spin_lock(&pattern_lock);
+    pattern.steps_count = 0;
+    k_spin_unlock(&pattern_lock, key);
 }
 
 static ssize_t write_do_state(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
                               uint16_t offset, uint8_t flags)
 {
+    uint32_t started_at = gatt_stats_begin();
+
     if (offset) {
+        gatt_stats_end(GATT_STATS_OP_WRITE, started_at, true);
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
     } else if (len != 1) {
+        gatt_stats_end(GATT_STATS_OP_WRITE, started_at, true);
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
     }
 
     uint8_t state = *(uint8_t *)buf;
-    leds_state = state;
-    update_led_state(&led0, 0, state & 0x01);
-    update_led_state(&led1, 1, state & 0x04);
-    update_led_state(&led2, 2, state & 0x10);
 
+    automation_io_service_stop_pattern();
+    update_leds_state(state);
+    LOG_DBG("LEDs state 0x%02x", state);
+
+    gatt_stats_end(GATT_STATS_OP_WRITE, started_at, false);
     return len;
 }
 
 static ssize_t read_do_state(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
                              uint16_t offset)
 {
+    uint32_t started_at = gatt_stats_begin();
     uint8_t state = leds_state;
 
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &state, sizeof(state));
+    ssize_t ret = bt_gatt_attr_read(conn, attr, buf, len, offset, &state, sizeof(state));
+    gatt_stats_end(GATT_STATS_OP_READ, started_at, ret < 0);
+
+    return ret;
 }
 
 static ssize_t read_num_of_digitals(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
                                     uint16_t offset)
 {
-    uint8_t num = *NUM_OF_DIGITALS;
+    uint8_t num = *(const uint8_t *)attr->user_data;
 
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &num, sizeof(num));
 }
 
+static ssize_t write_led_pattern(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                                 uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    struct led_pattern new_pattern = {0};
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len < LED_PATTERN_HEADER_SIZE || len > LED_PATTERN_SIZE_MAX ||
+               (len - LED_PATTERN_HEADER_SIZE) % LED_PATTERN_STEP_SIZE) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    // A pattern without steps just stops the playback
+    if (len == LED_PATTERN_HEADER_SIZE) {
+        automation_io_service_stop_pattern();
+        return len;
+    }
+
+    new_pattern.repeat = data[0];
+    new_pattern.steps_count = (len - LED_PATTERN_HEADER_SIZE) / LED_PATTERN_STEP_SIZE;
+    for (uint8_t i = 0; i < new_pattern.steps_count; i++) {
+        const uint8_t *step = &data[LED_PATTERN_HEADER_SIZE + i * LED_PATTERN_STEP_SIZE];
+        new_pattern.steps[i].state = step[0];
+        new_pattern.steps[i].duration_ms = sys_get_le16(&step[1]);
+    }
+
+    if (automation_io_service_play_pattern(&new_pattern)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    return len;
+}
+
+static ssize_t read_led_pattern(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                uint16_t offset)
+{
+    uint8_t data[LED_PATTERN_SIZE_MAX];
+    uint16_t size = LED_PATTERN_HEADER_SIZE;
+
+    k_spinlock_key_t key = k_spin_lock(&pattern_lock);
+
+    data[0] = pattern.repeat;
+    for (uint8_t i = 0; i < pattern.steps_count; i++) {
+        data[size] = pattern.steps[i].state;
+        sys_put_le16(pattern.steps[i].duration_ms, &data[size + 1]);
+        size += LED_PATTERN_STEP_SIZE;
+    }
+
+    k_spin_unlock(&pattern_lock, key);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, size);
+}
+
+static ssize_t write_header_state(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+                                  uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    uint16_t mask = 0;
+    uint16_t levels = 0;
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len != HEADER_DIGITAL_SIZE) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    // Only the inactive / active values are applied, the rest leave the pin untouched
+    for (uint8_t pin = 0; pin < HEADER_PINS_COUNT; pin++) {
+        uint8_t value = (data[pin / 4] >> ((pin % 4) * 2)) & 0x03;
+        if (value == DIGITAL_INACTIVE || value == DIGITAL_ACTIVE) {
+            mask |= BIT(pin);
+            levels |= value == DIGITAL_ACTIVE ? BIT(pin) : 0;
+        }
+    }
+
+    if (gpio_header_set_outputs(mask, levels)) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    return len;
+}
+
+static ssize_t read_header_state(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                 uint16_t offset)
+{
+    uint8_t data[HEADER_DIGITAL_SIZE] = {0};
+    uint16_t levels = gpio_header_get_levels();
+
+    for (uint8_t pin = 0; pin < HEADER_PINS_COUNT; pin++) {
+        uint8_t value;
+        if ((gpio_header_get_mode(pin) & GPIO_HEADER_MODE_DIRECTION_MASK) == GPIO_HEADER_MODE_DISABLED) {
+            value = DIGITAL_UNKNOWN;
+        } else {
+            value = (levels & BIT(pin)) ? DIGITAL_ACTIVE : DIGITAL_INACTIVE;
+        }
+        data[pin / 4] |= value << ((pin % 4) * 2);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
+}
+
+static ssize_t write_header_config(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+                                   uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len != HEADER_CONFIG_SIZE) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    uint16_t debounce_ms = sys_get_le16(data);
+
+    // The whole configuration is validated first, a rejected write changes nothing
+    if (debounce_ms > GPIO_HEADER_DEBOUNCE_MS_MAX) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+    for (uint8_t pin = 0; pin < HEADER_PINS_COUNT; pin++) {
+        if (gpio_header_get_mode(pin) != data[2 + pin] && gpio_header_check_mode(pin, data[2 + pin])) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+    }
+
+    gpio_header_set_debounce(debounce_ms);
+
+    for (uint8_t pin = 0; pin < HEADER_PINS_COUNT; pin++) {
+        if (gpio_header_get_mode(pin) == data[2 + pin]) {
+            continue;
+        }
+        if (gpio_header_configure(pin, data[2 + pin])) {
+            return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+        }
+    }
+
+    return len;
+}
+
+static ssize_t read_header_config(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                  uint16_t offset)
+{
+    uint8_t data[HEADER_CONFIG_SIZE];
+
+    sys_put_le16(gpio_header_get_debounce(), data);
+    for (uint8_t pin = 0; pin < HEADER_PINS_COUNT; pin++) {
+        data[2 + pin] = gpio_header_get_mode(pin);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
+}
+
+static ssize_t read_header_event(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                 uint16_t offset)
+{
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, header_event, sizeof(header_event));
+}
+
+static void header_event_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+    bool enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Header pins notifications %s", enabled ? "enabled" : "disabled");
+}
+
+static void header_event_update(const struct gpio_header_event *event)
+{
+    TRACE_POINT("aios_header_event", event->changed, event->levels);
+
+    sys_put_le32(event->timestamp_ms, &header_event[0]);
+    sys_put_le16(event->changed, &header_event[4]);
+    sys_put_le16(event->levels, &header_event[6]);
+    sys_put_le16(event->edges, &header_event[8]);
+
+    notification_dispatcher_submit(header_event_attr, header_event, sizeof(header_event));
+}
+
+static ssize_t read_analog(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                           uint16_t offset)
+{
+    uint8_t data[sizeof(uint16_t)];
+
+    // The latest filtered value, the notify threshold only limits the notifications
+    sys_put_le16(analog_header_get_millivolt(POINTER_TO_UINT(attr->user_data)), data);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
+}
+
+static void analog_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+    bool enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Analog notifications %s", enabled ? "enabled" : "disabled");
+}
+
+static void analog_value_update(uint8_t channel, uint16_t millivolt)
+{
+    uint8_t data[sizeof(uint16_t)];
+
+    if (channel >= ANALOG_CHANNELS_COUNT) {
+        return;
+    }
+
+    TRACE_POINT("aios_analog", channel, millivolt);
+
+    sys_put_le16(millivolt, data);
+    notification_dispatcher_submit(analog_attrs[channel], data, sizeof(data));
+}
+
+// Analog characteristic, CCC, format and the pin name for each of the analog header channels
+#define ANALOG_CHANNEL_ATTRS(node)                                                                                   \
+    BT_GATT_CHARACTERISTIC(BT_UUID_GATT_AI, (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ), BT_GATT_PERM_READ, read_analog, \
+                           NULL, UINT_TO_POINTER(DT_NODE_CHILD_IDX(node))),                                          \
+        BT_GATT_CCC(analog_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),                                 \
+        BT_GATT_CPF(&analog_att_format_cpf), BT_GATT_CUD(DT_NODE_FULL_NAME(node), BT_GATT_PERM_READ),
+
 BT_GATT_SERVICE_DEFINE(automation_io_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_AIOS),
                        BT_GATT_CHARACTERISTIC(BT_UUID_GATT_DO, (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_READ),
                                               (BT_GATT_PERM_WRITE | BT_GATT_PERM_READ), read_do_state, write_do_state,
                                               NULL),
                        BT_GATT_DESCRIPTOR(BT_UUID_GATT_NUM_OF_DIGITALS, BT_GATT_PERM_READ, read_num_of_digitals, NULL,
-                                          (void *)NUM_OF_DIGITALS), );
+                                          (void *)NUM_OF_DIGITALS),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_AIOS_LED_PATTERN, (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_READ),
+                                              (BT_GATT_PERM_WRITE | BT_GATT_PERM_READ), read_led_pattern,
+                                              write_led_pattern, NULL),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_GATT_DI, (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_READ),
+                                              (BT_GATT_PERM_WRITE | BT_GATT_PERM_READ), read_header_state,
+                                              write_header_state, NULL),
+                       BT_GATT_DESCRIPTOR(BT_UUID_GATT_NUM_OF_DIGITALS, BT_GATT_PERM_READ, read_num_of_digitals, NULL,
+                                          (void *)NUM_OF_HEADER_DIGITALS),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_AIOS_HEADER_CONFIG, (BT_GATT_CHRC_WRITE | BT_GATT_CHRC_READ),
+                                              (BT_GATT_PERM_WRITE | BT_GATT_PERM_READ), read_header_config,
+                                              write_header_config, NULL),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_AIOS_HEADER_EVENT, (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ),
+                                              BT_GATT_PERM_READ, read_header_event, NULL, NULL),
+                       BT_GATT_CCC(header_event_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+                       DT_FOREACH_CHILD(ANALOG_HEADER_NODE, ANALOG_CHANNEL_ATTRS));
 
 int automation_io_service_start(void)
 {
     int err;
 
-    err = gpio_pin_configure_dt(&led0, GPIO_OUTPUT_INACTIVE);
-    if (err) {
-        LOG_ERR("LED 0 pin configure failed (err %d)", err);
-        return err;
+    for (size_t i = 0; i < LEDS_COUNT; i++) {
+        if (leds[i].port != leds[0].port) {
+            LOG_ERR("LED %zu is not on the same port as LED 0", i);
+            return -ENOTSUP;
+        }
+
+        err = gpio_pin_configure_dt(&leds[i], GPIO_OUTPUT_INACTIVE);
+        if (err) {
+            LOG_ERR("LED %zu pin configure failed (err %d)", i, err);
+            return err;
+        }
+
+        leds_mask |= BIT(leds[i].pin);
     }
 
-    err = gpio_pin_configure_dt(&led1, GPIO_OUTPUT_INACTIVE);
+    k_timer_init(&pattern_timer, pattern_timer_expired, NULL);
+
+    err = gpio_header_init();
     if (err) {
-        LOG_ERR("LED 1 pin configure failed (err %d)", err);
+        LOG_ERR("Header pins initialization failed (err %d)", err);
         return err;
     }
 
-    err = gpio_pin_configure_dt(&led2, GPIO_OUTPUT_INACTIVE);
+    header_event_attr = bt_gatt_find_by_uuid(automation_io_service.attrs, automation_io_service.attr_count,
+                                             BT_UUID_AIOS_HEADER_EVENT);
+    gpio_header_register_event_callback(header_event_update);
+
+    for (size_t i = 0; i < automation_io_service.attr_count; i++) {
+        const struct bt_gatt_attr *attr = &automation_io_service.attrs[i];
+        for (size_t channel = 0; channel < ANALOG_CHANNELS_COUNT; channel++) {
+            if (attr->read == read_analog && POINTER_TO_UINT(attr->user_data) == channel) {
+                analog_attrs[channel] = attr;
+            }
+        }
+    }
+
+    analog_header_register_callback(analog_value_update);
+
+    err = analog_header_init();
     if (err) {
-        LOG_ERR("LED 2 pin configure failed (err %d)", err);
+        LOG_ERR("Analog header initialization failed (err %d)", err);
         return err;
     }
 
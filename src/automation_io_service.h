@@ -1,8 +1,39 @@
 #ifndef __AIOS_SERVICE_H__
 #define __AIOS_SERVICE_H__
 
+#include <stdint.h>
+
+// Maximum number of steps in a single LED pattern
+#define LED_PATTERN_STEPS_MAX 8
+
+struct led_pattern_step {
+    // LEDs state in the Digital characteristic format (2 bits per LED, 0b01 = On)
+    uint8_t state;
+    // Time to keep the state, in milliseconds
+    uint16_t duration_ms;
+};
+
+struct led_pattern {
+    // Number of times to play the steps sequence, 0 = repeat forever
+    uint8_t repeat;
+    uint8_t steps_count;
+    struct led_pattern_step steps[LED_PATTERN_STEPS_MAX];
+};
+
 int automation_io_service_start(void);
 
+/**
+ * @brief Play the LED pattern on the device, replacing the currently playing one.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int automation_io_service_play_pattern(const struct led_pattern *pattern);
+
+/**
+ * @brief Stop the currently playing LED pattern. The LEDs keep their last state.
+ */
+void automation_io_service_stop_pattern(void);
+
 #include <zephyr/bluetooth/bluetooth.h>
 
 // GATT Descriptor Number of Digitals UUID Value
@@ -10,4 +41,19 @@ int automation_io_service_start(void);
 // GATT Descriptor Number of Digitals
 #define BT_UUID_GATT_NUM_OF_DIGITALS BT_UUID_DECLARE_16(BT_UUID_GATT_NUM_OF_DIGITALS_VAL)
 
-#endif  //__AIOS_SERVICE_H__
\ No newline at end of file
+// LED Pattern Characteristic UUID Value
+#define BT_UUID_AIOS_LED_PATTERN_VAL BT_UUID_128_ENCODE(0x8e7f0001, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// LED Pattern Characteristic
+#define BT_UUID_AIOS_LED_PATTERN BT_UUID_DECLARE_128(BT_UUID_AIOS_LED_PATTERN_VAL)
+
+// Header Pins Configuration Characteristic UUID Value
+#define BT_UUID_AIOS_HEADER_CONFIG_VAL BT_UUID_128_ENCODE(0x8e7f0002, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Header Pins Configuration Characteristic
+#define BT_UUID_AIOS_HEADER_CONFIG BT_UUID_DECLARE_128(BT_UUID_AIOS_HEADER_CONFIG_VAL)
+
+// Header Pins Event Characteristic UUID Value
+#define BT_UUID_AIOS_HEADER_EVENT_VAL BT_UUID_128_ENCODE(0x8e7f0003, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Header Pins Event Characteristic
+#define BT_UUID_AIOS_HEADER_EVENT BT_UUID_DECLARE_128(BT_UUID_AIOS_HEADER_EVENT_VAL)
+
+#endif  //__AIOS_SERVICE_H__
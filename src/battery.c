@@ -15,6 +15,8 @@
  */
 
 #include "battery.h"
+#include "adc_scan.h"
+#include "trace_points.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
@@ -23,7 +25,7 @@
 #include <zephyr/drivers/adc.h>
 #include <zephyr/logging/log.h>
 
-LOG_MODULE_REGISTER(battery, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(battery, LOG_LEVEL_DBG);
 
 #if !DT_NODE_EXISTS(DT_NODELABEL(xiao_ble_battery_dev))
 #error "Overlay for xiao_ble_battery_dev node not properly defined."
@@ -32,9 +34,16 @@ LOG_MODULE_REGISTER(battery, LOG_LEVEL_INF);
 #define BATTERY_NODE DT_NODELABEL(xiao_ble_battery_dev)
 #define BATTERY_CALLBACK_MAX DT_PROP(BATTERY_NODE, battery_callbacks_max)
 
+#define ADC_OVERSAMPLING DT_PROP(BATTERY_NODE, adc_oversampling)
+
+#if ADC_OVERSAMPLING
+// The SAADC hardware averages the conversions into a single sample
+#define ADC_TOTAL_SAMPLES 1
+#else
 // Change this to a higher number for better averages
 // Note that increasing this holds up the thread / ADC for longer.
 #define ADC_TOTAL_SAMPLES DT_PROP(BATTERY_NODE, adc_total_samples)
+#endif
 
 //--------------------------------------------------------------
 // ADC setup
@@ -49,7 +58,12 @@ LOG_MODULE_REGISTER(battery, LOG_LEVEL_INF);
 #define ADC_GAIN                DT_PROP(BATTERY_NODE, adc_gain) 
 #define ADC_SAMPLE_INTERVAL_US  DT_PROP(BATTERY_NODE, adc_sample_interval)
 #define ADC_ACQUISITION_TIME    DT_PROP(BATTERY_NODE, adc_acquisition_time) 
+#if ADC_OVERSAMPLING
+// Nothing left to filter in software
+#define ADC_FILTERING_ALGORITHM ADC_FILTERING_ALGORITHM_AVERAGE
+#else
 #define ADC_FILTERING_ALGORITHM DT_ENUM_IDX(BATTERY_NODE, adc_filtering_algorithm)
+#endif
 
 #if ADC_FILTERING_ALGORITHM == ADC_FILTERING_ALGORITHM_TRIMMED_MEAN
 #include <stdlib.h>
@@ -65,19 +79,8 @@ static struct adc_channel_cfg channel_7_cfg = {
 #endif
 };
 
-static struct adc_sequence_options options = {
-    .extra_samplings = ADC_TOTAL_SAMPLES - 1,
-    .interval_us = ADC_SAMPLE_INTERVAL_US,
-};
-
+// Battery channel samples, copied out of the shared SAADC scan sequence (see adc_scan.c)
 static int16_t sample_buffer[ADC_TOTAL_SAMPLES];
-static struct adc_sequence sequence = {
-    .options = &options,
-    .channels = BIT(ADC_CHANNEL),
-    .buffer = sample_buffer,
-    .buffer_size = sizeof(sample_buffer),
-    .resolution = ADC_RESOLUTION,
-};
 
 //--------------------------------------------------------------
 // Local variables
@@ -144,6 +147,7 @@ static int battery_enable_read()
 static void run_charging_callbacks(struct k_work *work)
 {
     bool is_charging = gpio_pin_get_dt(&charging_enable);
+    TRACE_POINT("bat_charging", is_charging, 0);
     LOG_DBG("Charger %s", is_charging ? "connected" : "disconnected");
 
     for (uint8_t callback = 0; callback < charging_callbacks_registered; callback++)
@@ -170,8 +174,10 @@ static void charging_callback_handler(const struct device *dev,
 
 static void sample_periodic_handler(struct k_work *work)
 {
-    uint16_t millivolt;
+    uint16_t millivolt = 0;
+    TRACE_POINT("bat_sample_begin", 0, 0);
     int ret = battery_get_millivolt(&millivolt);
+    TRACE_POINT("bat_sample_end", millivolt, ret);
     if (ret)
     {
         LOG_ERR("Failed to get battery voltage");
@@ -199,6 +205,14 @@ static void sample_once_handler(struct k_work *work)
     run_sample_ready_callbacks(millivolt);
 }
 
+static void battery_samples_ready(const int16_t *samples, size_t count, size_t stride, void *user_data)
+{
+    for (size_t sample = 0; sample < count && sample < ADC_TOTAL_SAMPLES; sample++)
+    {
+        sample_buffer[sample] = samples[sample * stride];
+    }
+}
+
 #if ADC_FILTERING_ALGORITHM == ADC_FILTERING_ALGORITHM_TRIMMED_MEAN
 static int sample_buffer_compare(const void *a, const void *b)
 {
@@ -273,7 +287,8 @@ int battery_get_millivolt(uint16_t *battery_millivolt)
         return ret;
     }
 
-    ret |= adc_read(adc_battery_dev, &sequence);
+    // A single scan converts the battery together with the other analog channels
+    ret |= adc_scan_read();
 
     if (ret)
     {
@@ -403,7 +418,7 @@ int battery_init()
         return -EIO;
     }
 
-    ret |= adc_channel_setup(adc_battery_dev, &channel_7_cfg);
+    ret |= adc_scan_add_channel(&channel_7_cfg, battery_samples_ready, NULL);
     if (ret)
     {
         LOG_ERR("ADC setup failed (error %d)", ret);
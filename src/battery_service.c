@@ -1,16 +1,61 @@
 #include "battery_service.h"
 
+#include <stdlib.h>
+#include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/services/bas.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 
+#include "advertising.h"
 #include "battery.h"
+#include "log_ratelimit.h"
+#include "notification_dispatcher.h"
 
 #define SAMPLING_INTERVAL_MS 15000
+// The reported battery level only follows the smoothed one once it moves by this many percent
+#define BATTERY_LEVEL_STEP 5
+#define BATTERY_LEVEL_LOW 20
+#define BATTERY_LEVEL_CRITICAL 10
+// Smoothing factor of the battery voltage, every sample is blended in by 1/2^n
+#define MILLIVOLT_FILTER_SHIFT 2
 
-LOG_MODULE_REGISTER(battery_service, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(battery_service, LOG_LEVEL_DBG);
 
 static volatile bool is_charging = false;
 static volatile uint16_t last_millivolt = 0;
+static int64_t sample_logged_at_ms = 0;
+static uint32_t filtered_millivolt = 0;
+static int16_t reported_level = -1;
+static atomic_t charger_state = ATOMIC_INIT(0);
+static const struct bt_gatt_attr *charger_state_attr;
+
+static void charger_state_update(void);
+
+static enum bt_bas_bls_battery_charge_level charge_level(uint8_t level)
+{
+    if (level <= BATTERY_LEVEL_CRITICAL) {
+        return BT_BAS_BLS_CHARGE_LEVEL_CRITICAL;
+    } else if (level <= BATTERY_LEVEL_LOW) {
+        return BT_BAS_BLS_CHARGE_LEVEL_LOW;
+    }
+    return BT_BAS_BLS_CHARGE_LEVEL_GOOD;
+}
+
+static bool is_level_report_due(uint8_t percentage)
+{
+    if (reported_level < 0) {
+        return true;
+    }
+
+    // Both the full battery and the critical threshold are reported as soon as they are reached
+    if (percentage != reported_level && (percentage == 100 || percentage == 0)) {
+        return true;
+    } else if (charge_level(percentage) != charge_level(reported_level)) {
+        return true;
+    }
+
+    return abs(percentage - reported_level) >= BATTERY_LEVEL_STEP;
+}
 
 static void battery_voltage_update(uint16_t millivolt)
 {
@@ -23,21 +68,93 @@ static void battery_voltage_update(uint16_t millivolt)
     }
     last_millivolt = millivolt;
 
-    int err = battery_get_percentage(&percentage, millivolt);
+    // The first sample primes the filter, the next ones are blended in
+    if (filtered_millivolt == 0) {
+        filtered_millivolt = millivolt << MILLIVOLT_FILTER_SHIFT;
+    } else {
+        filtered_millivolt += millivolt - (filtered_millivolt >> MILLIVOLT_FILTER_SHIFT);
+    }
+
+    int err = battery_get_percentage(&percentage, filtered_millivolt >> MILLIVOLT_FILTER_SHIFT);
     if (err) {
         LOG_ERR("Failed to calculate battery percentage");
         return;
     }
 
-    LOG_INF("Battery is at %d mV (capacity %d%%, %s)", millivolt, percentage, is_charging ? "charging" : "discharging");
+    if (log_ratelimit_allow(&sample_logged_at_ms, SAMPLE_LOG_INTERVAL_MS)) {
+        LOG_INF("Battery is at %d mV (capacity %d%%, %s)", millivolt, percentage,
+                is_charging ? "charging" : "discharging");
+    }
+
+    if (!is_level_report_due(percentage)) {
+        return;
+    }
+    reported_level = percentage;
 
     bt_bas_set_battery_level(percentage);
+    bt_bas_bls_set_battery_charge_level(charge_level(percentage));
+    advertising_update_battery_level(percentage);
+
+    bool is_critical = charge_level(percentage) == BT_BAS_BLS_CHARGE_LEVEL_CRITICAL;
+    if (is_critical != ((atomic_get(&charger_state) & CHARGER_STATE_CRITICAL) != 0)) {
+        atomic_xor(&charger_state, CHARGER_STATE_CRITICAL);
+        charger_state_update();
+    }
 }
 
 static void battery_charging_state_update(bool connected)
 {
     is_charging = connected;
     LOG_INF("Charger %s", connected ? "connected" : "disconnected");
+
+    if (connected) {
+        atomic_or(&charger_state, CHARGER_STATE_CHARGING);
+    } else {
+        atomic_and(&charger_state, ~CHARGER_STATE_CHARGING);
+    }
+    charger_state_update();
+}
+
+static ssize_t read_charger_state(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                  uint16_t offset)
+{
+    uint8_t state = atomic_get(&charger_state);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &state, sizeof(state));
+}
+
+BT_GATT_SERVICE_DEFINE(charger_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_CHARGER_SERVICE),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_CHARGER_STATE, (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ),
+                                              BT_GATT_PERM_READ, read_charger_state, NULL, NULL),
+                       BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
+
+static void charger_state_update(void)
+{
+    uint8_t state = atomic_get(&charger_state);
+
+    bt_bas_bls_set_wired_external_power_source(is_charging ? BT_BAS_BLS_WIRED_POWER_CONNECTED
+                                                           : BT_BAS_BLS_WIRED_POWER_NOT_CONNECTED);
+    bt_bas_bls_set_battery_charge_state(is_charging ? BT_BAS_BLS_CHARGE_STATE_CHARGING
+                                                    : BT_BAS_BLS_CHARGE_STATE_DISCHARGING_ACTIVE);
+
+    notification_dispatcher_submit(charger_state_attr, &state, sizeof(state));
+}
+
+int battery_service_set_fast_charge(bool fast)
+{
+    int err = fast ? battery_set_fast_charge() : battery_set_slow_charge();
+    if (err) {
+        return err;
+    }
+
+    if (fast) {
+        atomic_or(&charger_state, CHARGER_STATE_FAST_CHARGE);
+    } else {
+        atomic_and(&charger_state, ~CHARGER_STATE_FAST_CHARGE);
+    }
+    charger_state_update();
+
+    return 0;
 }
 
 int battery_service_start(void)
@@ -45,6 +162,8 @@ int battery_service_start(void)
     uint16_t battery_millivolt;
     int err;
 
+    charger_state_attr = bt_gatt_find_by_uuid(charger_service.attrs, charger_service.attr_count, BT_UUID_CHARGER_STATE);
+
     err = battery_init();
     if (err) {
         LOG_ERR("Failed to initialize battery management (error %d)", err);
@@ -63,13 +182,19 @@ int battery_service_start(void)
         return err;
     }
 
-    err = battery_set_fast_charge();
+    bt_bas_bls_set_battery_present(BT_BAS_BLS_BATTERY_PRESENT);
+
+    is_charging = battery_is_charging();
+    if (is_charging) {
+        atomic_or(&charger_state, CHARGER_STATE_CHARGING);
+    }
+
+    err = battery_service_set_fast_charge(true);
     if (err) {
         LOG_ERR("Failed to set battery fast charging (error %d)", err);
         return err;
     }
 
-    is_charging = battery_is_charging();
     battery_get_millivolt(&battery_millivolt);
     last_millivolt = battery_millivolt;
     battery_voltage_update(battery_millivolt);
@@ -77,4 +202,4 @@ int battery_service_start(void)
     battery_start_sampling(SAMPLING_INTERVAL_MS);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,31 @@
 #ifndef __BATTERY_SERVICE_H__
 #define __BATTERY_SERVICE_H__
 
+#include <stdbool.h>
+#include <zephyr/bluetooth/uuid.h>
+
+// Charger Service UUID Value
+#define BT_UUID_CHARGER_SERVICE_VAL BT_UUID_128_ENCODE(0x8e7f0200, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Charger Service
+#define BT_UUID_CHARGER_SERVICE BT_UUID_DECLARE_128(BT_UUID_CHARGER_SERVICE_VAL)
+
+// Charger State Characteristic UUID Value
+#define BT_UUID_CHARGER_STATE_VAL BT_UUID_128_ENCODE(0x8e7f0201, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Charger State Characteristic
+#define BT_UUID_CHARGER_STATE BT_UUID_DECLARE_128(BT_UUID_CHARGER_STATE_VAL)
+
+// Charger State Characteristic flags
+#define CHARGER_STATE_CHARGING BIT(0)
+#define CHARGER_STATE_FAST_CHARGE BIT(1)
+#define CHARGER_STATE_CRITICAL BIT(2)
+
 int battery_service_start(void);
 
-#endif  //__BATTERY_SERVICE_H__
\ No newline at end of file
+/**
+ * @brief Select the fast (100mA) or the slow (50mA) charging current and notify the charger state.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int battery_service_set_fast_charge(bool fast);
+
+#endif  //__BATTERY_SERVICE_H__
@@ -0,0 +1,79 @@
+#include "buffer_pool.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+K_MEM_SLAB_DEFINE_STATIC(pool, BUFFER_POOL_BLOCK_SIZE, BUFFER_POOL_BLOCKS, 4);
+
+// Maximum of the blocks each user may hold at once
+static const uint32_t user_limits[BUFFER_POOL_USERS_COUNT] = {
+    [BUFFER_POOL_USER_ESS_FRAME] = BUFFER_POOL_ESS_FRAME_BLOCKS,
+    [BUFFER_POOL_USER_ADC_SCAN] = BUFFER_POOL_ADC_SCAN_BLOCKS,
+};
+
+static struct buffer_pool_stats stats[BUFFER_POOL_USERS_COUNT];
+static uint32_t used = 0;
+static uint32_t used_max = 0;
+static struct k_spinlock lock;
+
+void *buffer_pool_alloc(enum buffer_pool_user user)
+{
+    void *block = NULL;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (stats[user].used == user_limits[user] || k_mem_slab_alloc(&pool, &block, K_NO_WAIT)) {
+        stats[user].failed++;
+        k_spin_unlock(&lock, key);
+        return NULL;
+    }
+
+    stats[user].used++;
+    stats[user].used_max = MAX(stats[user].used_max, stats[user].used);
+    used++;
+    used_max = MAX(used_max, used);
+
+    k_spin_unlock(&lock, key);
+    return block;
+}
+
+void buffer_pool_free(enum buffer_pool_user user, void *block)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    k_mem_slab_free(&pool, block);
+    stats[user].used--;
+    used--;
+
+    k_spin_unlock(&lock, key);
+}
+
+void buffer_pool_get_stats(enum buffer_pool_user user, struct buffer_pool_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = stats[user];
+    k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const user_names[BUFFER_POOL_USERS_COUNT] = {"ess_frame", "adc_scan"};
+
+static int cmd_buffer_pool(const struct shell *sh, size_t argc, char **argv)
+{
+    struct buffer_pool_stats user_stats;
+
+    shell_print(sh, "%u blocks of %u bytes, used %u (max %u)", BUFFER_POOL_BLOCKS, BUFFER_POOL_BLOCK_SIZE, used,
+                used_max);
+
+    for (size_t user = 0; user < BUFFER_POOL_USERS_COUNT; user++) {
+        buffer_pool_get_stats(user, &user_stats);
+        shell_print(sh, "%-12s used %u (max %u of %u) failed %u", user_names[user], user_stats.used,
+                    user_stats.used_max, user_limits[user], user_stats.failed);
+    }
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(buffer_pool, NULL, "Shared buffer pool usage", cmd_buffer_pool);
+#endif
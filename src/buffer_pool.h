@@ -0,0 +1,49 @@
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <stdint.h>
+#include <zephyr/devicetree.h>
+
+// Fits a BME280 RTIO frame or an oversampled ADC scan sequence
+#define BUFFER_POOL_BLOCK_SIZE 32
+// One frame per enabled BME280, held for the duration of a sample
+#define BUFFER_POOL_ESS_FRAME_BLOCKS DT_NUM_INST_STATUS_OKAY(bosch_bme280)
+// The scans are serialized, a single sequence is held at once
+#define BUFFER_POOL_ADC_SCAN_BLOCKS 1
+#define BUFFER_POOL_BLOCKS (BUFFER_POOL_ESS_FRAME_BLOCKS + BUFFER_POOL_ADC_SCAN_BLOCKS)
+
+enum buffer_pool_user {
+    BUFFER_POOL_USER_ESS_FRAME,
+    BUFFER_POOL_USER_ADC_SCAN,
+    BUFFER_POOL_USERS_COUNT,
+};
+
+struct buffer_pool_stats {
+    // Blocks currently held
+    uint32_t used;
+    // High-water mark of the blocks held at once
+    uint32_t used_max;
+    // Allocations refused because the pool or the user's share was exhausted
+    uint32_t failed;
+};
+
+/**
+ * @brief Take a block of BUFFER_POOL_BLOCK_SIZE bytes, without waiting.
+ *
+ * @param[in] user Feature the block is accounted to.
+ *
+ * @return Block, or NULL when none is available.
+ */
+void *buffer_pool_alloc(enum buffer_pool_user user);
+
+/**
+ * @brief Give back a block taken by buffer_pool_alloc for the same user.
+ */
+void buffer_pool_free(enum buffer_pool_user user, void *block);
+
+/**
+ * @brief Get the blocks usage of the user.
+ */
+void buffer_pool_get_stats(enum buffer_pool_user user, struct buffer_pool_stats *stats);
+
+#endif  //__BUFFER_POOL_H__
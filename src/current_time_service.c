@@ -0,0 +1,111 @@
+#include <string.h>
+#include <time.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/timeutil.h>
+
+#include "device_clock.h"
+#include "notification_dispatcher.h"
+
+LOG_MODULE_REGISTER(current_time_service, LOG_LEVEL_DBG);
+
+/*
+ * Current Time characteristic layout: year (uint16), month, day, hours, minutes, seconds,
+ * day of week (1 = Monday ... 7 = Sunday, 0 = unknown), fractions of a second (1/256), adjust reason
+ */
+#define CURRENT_TIME_SIZE 10
+#define ADJUST_REASON_MANUAL_UPDATE BIT(0)
+
+static void current_time_encode(uint8_t *data)
+{
+    uint64_t unix_ms;
+    struct tm tm;
+
+    memset(data, 0, CURRENT_TIME_SIZE);
+
+    // Year 0 tells the time is not known yet
+    if (device_clock_now(&unix_ms)) {
+        return;
+    }
+
+    time_t seconds = unix_ms / MSEC_PER_SEC;
+    gmtime_r(&seconds, &tm);
+
+    sys_put_le16(tm.tm_year + 1900, &data[0]);
+    data[2] = tm.tm_mon + 1;
+    data[3] = tm.tm_mday;
+    data[4] = tm.tm_hour;
+    data[5] = tm.tm_min;
+    data[6] = tm.tm_sec;
+    data[7] = tm.tm_wday == 0 ? 7 : tm.tm_wday;
+    data[8] = (unix_ms % MSEC_PER_SEC) * 256 / MSEC_PER_SEC;
+}
+
+static ssize_t read_current_time(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                 uint16_t offset)
+{
+    uint8_t data[CURRENT_TIME_SIZE];
+
+    current_time_encode(data);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
+}
+
+static ssize_t write_current_time(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                                  uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len != CURRENT_TIME_SIZE) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    struct tm tm = {
+        .tm_year = sys_get_le16(&data[0]) - 1900,
+        .tm_mon = data[2] - 1,
+        .tm_mday = data[3],
+        .tm_hour = data[4],
+        .tm_min = data[5],
+        .tm_sec = data[6],
+    };
+
+    if (tm.tm_year < 70 || tm.tm_mon < 0 || tm.tm_mon > 11 || tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour > 23 ||
+        tm.tm_min > 59 || tm.tm_sec > 59) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    uint64_t unix_ms = timeutil_timegm64(&tm) * MSEC_PER_SEC + data[8] * MSEC_PER_SEC / 256;
+
+    int err = device_clock_sync(unix_ms);
+    if (err) {
+        LOG_WRN("Clock synchronization failed (err %d)", err);
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    // Let the other subscribed clients know the time was adjusted
+    uint8_t notification[CURRENT_TIME_SIZE];
+    current_time_encode(notification);
+    notification[9] = ADJUST_REASON_MANUAL_UPDATE;
+    notification_dispatcher_submit(attr, notification, sizeof(notification));
+
+    return len;
+}
+
+static void current_time_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+    bool enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Current time notifications %s", enabled ? "enabled" : "disabled");
+}
+
+BT_GATT_SERVICE_DEFINE(current_time_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_CTS),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_CTS_CURRENT_TIME,
+                                              (BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY),
+                                              (BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_ENCRYPT), read_current_time,
+                                              write_current_time, NULL),
+                       BT_GATT_CCC(current_time_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
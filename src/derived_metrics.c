@@ -0,0 +1,91 @@
+#include "derived_metrics.h"
+
+#include <zephyr/sys/util.h>
+
+// log2(1 + i/32) in Q24
+static const int32_t log2_table[32] = {
+    0,        744810,   1467383,  2169009,  2850868,  3514044,  4159533,  4788255,
+    5401057,  5998727,  6581994,  7151536,  7707984,  8251926,  8783912,  9304457,
+    9814042,  10313120, 10802114, 11281425, 11751428, 12212479, 12664911, 13109041,
+    13545168, 13973576, 14394532, 14808293, 15215099, 15615181, 16008758, 16396036,
+};
+
+// 2^(i/32) in Q30
+static const uint32_t exp2_table[32] = {
+    1073741824, 1097253708, 1121280436, 1145833280, 1170923762, 1196563654, 1222764986, 1249540052,
+    1276901417, 1304861917, 1333434672, 1362633090, 1392470869, 1422962010, 1454120821, 1485961921,
+    1518500250, 1551751076, 1585730000, 1620452965, 1655936265, 1692196547, 1729250827, 1767116489,
+    1805811301, 1845353420, 1885761398, 1927054196, 1969251188, 2012372174, 2056437387, 2101467502,
+};
+
+#define LN2_Q30 744261118LL
+#define LOG2E_Q30 1549082005LL
+
+// Magnus coefficients: b = 17.62, c = 243.12 DegC
+#define MAGNUS_B_Q24 295614546LL
+#define MAGNUS_B_X100 1762
+#define MAGNUS_C 24312
+
+// Standard atmosphere: p = p0 * (1 - h / 44330.77 m)^5.25588
+#define SEA_LEVEL_PRESSURE 1013250
+#define BAROMETRIC_HEIGHT 4433077LL
+#define BAROMETRIC_EXPONENT_Q24 88179034LL
+#define BAROMETRIC_EXPONENT_INV_Q30 204293444LL
+
+// log2(x) in Q24, x > 0
+static int32_t log2_q24(uint32_t x)
+{
+    int32_t n = 31 - __builtin_clz(x);
+    // Mantissa fraction in Q31, the upper 5 bits select the table entry
+    uint32_t f = (x << (31 - n)) - BIT(31);
+    uint32_t i = f >> 26;
+    // log2(1 + d) = ln(1 + d) / ln(2), with d < 1/32 relative to the table entry
+    int64_t d = ((int64_t)(f & BIT_MASK(26)) * 32) / (32 + i);
+    int64_t d2 = (d * d) >> 31;
+    int64_t d3 = (d2 * d) >> 31;
+    int64_t ln1p = d - d2 / 2 + d3 / 3;
+
+    return (n << 24) + log2_table[i] + (int32_t)(((ln1p * LOG2E_Q30) >> 30) >> 7);
+}
+
+// 2^y in Q30, y in Q24 within (-30, 2)
+static uint32_t exp2_q30(int32_t y)
+{
+    int32_t k = y >> 24;
+    uint32_t f = (uint32_t)y & BIT_MASK(24);
+    uint32_t i = f >> 19;
+    // 2^r = e^(r * ln(2)), with r < 1/32
+    int64_t x = ((int64_t)(f & BIT_MASK(19)) << 6) * LN2_Q30 >> 30;
+    int64_t x2 = (x * x) >> 30;
+    int64_t x3 = (x2 * x) >> 30;
+    uint64_t mantissa = ((uint64_t)exp2_table[i] * (uint64_t)(BIT(30) + x + x2 / 2 + x3 / 6)) >> 30;
+
+    return k <= 0 ? mantissa >> -k : mantissa << k;
+}
+
+int32_t derived_metrics_dew_point(int32_t temperature, uint32_t humidity)
+{
+    // gamma = ln(RH) + b * T / (c + T)
+    int64_t ln_rh = ((int64_t)(log2_q24(humidity) - log2_q24(10000)) * LN2_Q30) >> 30;
+    int64_t gamma = ln_rh + ((int64_t)MAGNUS_B_X100 * temperature * (1LL << 24)) / (100LL * (MAGNUS_C + temperature));
+
+    return (MAGNUS_C * gamma) / (MAGNUS_B_Q24 - gamma);
+}
+
+int32_t derived_metrics_pressure_altitude(uint32_t pressure)
+{
+    // h = 44330.77 * (1 - (p / p0)^(1 / 5.25588))
+    int32_t y = ((int64_t)(log2_q24(pressure) - log2_q24(SEA_LEVEL_PRESSURE)) * BAROMETRIC_EXPONENT_INV_Q30) >> 30;
+
+    return (BAROMETRIC_HEIGHT * ((1LL << 30) - exp2_q30(y))) >> 30;
+}
+
+uint32_t derived_metrics_sea_level_pressure(uint32_t pressure, int32_t elevation)
+{
+    // p0 = p * (1 - h / 44330.77)^-5.25588
+    elevation = CLAMP(elevation, DERIVED_METRICS_ELEVATION_MIN, DERIVED_METRICS_ELEVATION_MAX);
+    uint32_t ratio = BIT(30) - ((int64_t)elevation * (1LL << 30)) / BAROMETRIC_HEIGHT;
+    int32_t y = -(((int64_t)(log2_q24(ratio) - (30 << 24)) * BAROMETRIC_EXPONENT_Q24) >> 24);
+
+    return ((uint64_t)pressure * exp2_q30(y)) >> 30;
+}
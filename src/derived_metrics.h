@@ -0,0 +1,45 @@
+#ifndef __DERIVED_METRICS_H__
+#define __DERIVED_METRICS_H__
+
+#include <stdint.h>
+
+/*
+ * Integer only metrics derived from the BME280 values, computed with log2/exp2 lookup tables refined
+ * by short polynomials. Compared to the float formulas over -40..85 DegC, 1..100 %RH, 300..1100 hPa
+ * and -500..9000 m, the results stay within 0.02 DegC, 0.02 m and 0.2 Pa.
+ */
+
+// Valid range of the reference elevation, in 0.01 m
+#define DERIVED_METRICS_ELEVATION_MIN (-50000)
+#define DERIVED_METRICS_ELEVATION_MAX 900000
+
+/**
+ * @brief Dew point (Magnus formula, b = 17.62, c = 243.12 DegC).
+ *
+ * @param[in] temperature Temperature in 0.01 DegC.
+ * @param[in] humidity Relative humidity in 0.01 %RH, greater than zero.
+ *
+ * @return Dew point in 0.01 DegC.
+ */
+int32_t derived_metrics_dew_point(int32_t temperature, uint32_t humidity);
+
+/**
+ * @brief Pressure altitude against the standard atmosphere (1013.25 hPa at the sea level).
+ *
+ * @param[in] pressure Pressure in 0.1 Pa, greater than zero.
+ *
+ * @return Altitude in 0.01 m.
+ */
+int32_t derived_metrics_pressure_altitude(uint32_t pressure);
+
+/**
+ * @brief Pressure corrected to the sea level with the barometric formula.
+ *
+ * @param[in] pressure Pressure in 0.1 Pa.
+ * @param[in] elevation Elevation of the sensor in 0.01 m, within the DERIVED_METRICS_ELEVATION range.
+ *
+ * @return Sea level pressure in 0.1 Pa.
+ */
+uint32_t derived_metrics_sea_level_pressure(uint32_t pressure, int32_t elevation);
+
+#endif  //__DERIVED_METRICS_H__
@@ -0,0 +1,97 @@
+#include "device_clock.h"
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/timeutil.h>
+
+LOG_MODULE_REGISTER(device_clock, LOG_LEVEL_DBG);
+
+// Synchronizations closer than this are too noisy for the skew estimation
+#define SKEW_ESTIMATION_SPAN_TICKS (600ULL * CONFIG_SYS_CLOCK_TICKS_PER_SEC)
+// A larger skew means the reference time jumped, the estimation starts over
+#define SKEW_MAX_PPB 1000000
+
+static const struct timeutil_sync_config sync_config = {
+    .ref_Hz = MSEC_PER_SEC,
+    .local_Hz = CONFIG_SYS_CLOCK_TICKS_PER_SEC,
+};
+
+// Conversion state, rebased on every synchronization
+static struct timeutil_sync_state sync_state = {.cfg = &sync_config};
+// Skew estimation state, rebased once the synchronizations span long enough
+static struct timeutil_sync_state skew_state = {.cfg = &sync_config};
+static struct k_spinlock lock;
+
+int device_clock_sync(uint64_t unix_ms)
+{
+    struct timeutil_sync_instant instant = {.ref = unix_ms, .local = k_uptime_ticks()};
+    int32_t skew_ppb = 0;
+    int err;
+
+    if (unix_ms == 0) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    err = timeutil_sync_state_update(&skew_state, &instant);
+    if (err < 0) {
+        // The reference time went backwards, start over from this instant
+        skew_state = (struct timeutil_sync_state){.cfg = &sync_config};
+        err = timeutil_sync_state_update(&skew_state, &instant);
+    } else if (err > 0 && skew_state.latest.local - skew_state.base.local >= SKEW_ESTIMATION_SPAN_TICKS) {
+        float skew = timeutil_sync_estimate_skew(&skew_state);
+        skew_ppb = timeutil_sync_skew_to_ppb(skew);
+
+        if (abs(skew_ppb) <= SKEW_MAX_PPB) {
+            timeutil_sync_state_set_skew(&skew_state, skew, &skew_state.latest);
+        } else {
+            skew_state = (struct timeutil_sync_state){.cfg = &sync_config};
+            err = timeutil_sync_state_update(&skew_state, &instant);
+        }
+    }
+
+    if (err >= 0) {
+        timeutil_sync_state_set_skew(&sync_state, skew_state.skew, &instant);
+        skew_ppb = timeutil_sync_skew_to_ppb(sync_state.skew);
+    }
+
+    k_spin_unlock(&lock, key);
+
+    if (err < 0) {
+        return err;
+    }
+
+    LOG_INF("Clock synchronized (skew %d ppb)", skew_ppb);
+    return 0;
+}
+
+int device_clock_from_uptime(int64_t uptime_ms, uint64_t *unix_ms)
+{
+    int err;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    if (sync_state.base.ref == 0) {
+        err = -EAGAIN;
+    } else {
+        err = timeutil_sync_ref_from_local(&sync_state, k_ms_to_ticks_floor64(uptime_ms), unix_ms);
+    }
+    k_spin_unlock(&lock, key);
+
+    return err < 0 ? err : 0;
+}
+
+int device_clock_now(uint64_t *unix_ms)
+{
+    return device_clock_from_uptime(k_uptime_get(), unix_ms);
+}
+
+int32_t device_clock_skew_ppb(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int32_t skew_ppb = timeutil_sync_skew_to_ppb(sync_state.skew);
+    k_spin_unlock(&lock, key);
+
+    return skew_ppb;
+}
@@ -0,0 +1,41 @@
+#ifndef __DEVICE_CLOCK_H__
+#define __DEVICE_CLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Synchronize the device clock to the reference time, e.g. written by a gateway.
+ *
+ * The skew of the local clock is estimated from the successive synchronizations, once they span
+ * long enough, and applied to the conversions until the next one.
+ *
+ * @param[in] unix_ms Reference time in milliseconds since the Unix epoch.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int device_clock_sync(uint64_t unix_ms);
+
+/**
+ * @brief Convert the uptime to the reference time.
+ *
+ * @param[in] uptime_ms Uptime in milliseconds, as returned by k_uptime_get.
+ * @param[out] unix_ms Reference time in milliseconds since the Unix epoch.
+ *
+ * @retval 0 if successful. -EAGAIN if the clock was never synchronized.
+ */
+int device_clock_from_uptime(int64_t uptime_ms, uint64_t *unix_ms);
+
+/**
+ * @brief Get the current reference time.
+ *
+ * @retval 0 if successful. -EAGAIN if the clock was never synchronized.
+ */
+int device_clock_now(uint64_t *unix_ms);
+
+/**
+ * @brief Get the estimated skew of the local clock in parts per billion.
+ */
+int32_t device_clock_skew_ppb(void);
+
+#endif  //__DEVICE_CLOCK_H__
@@ -1,6 +1,5 @@
 #include "environmental_service.h"
 
-#include <math.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/device.h>
@@ -10,178 +9,781 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/rtio/rtio.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "advertising.h"
+#include "buffer_pool.h"
+#include "derived_metrics.h"
+#include "device_clock.h"
+#include "gatt_stats.h"
+#include "log_ratelimit.h"
+#include "notification_dispatcher.h"
+#include "pressure_trend.h"
+#include "trace_points.h"
+
+LOG_MODULE_REGISTER(environmental_service, LOG_LEVEL_DBG);
+
+// Default sampling interval, until environmental_service_set_sampling_interval changes it
+#define SAMPLING_INTERVAL_MS 15000
+// A read of older values takes a fresh sample first, 0 always returns the periodically sampled ones
+#define READ_MAX_AGE_MS 2000
+// Longest a read waits for the fresh sample before it returns the values it has, about a BME280 conversion
+#define READ_SAMPLE_WAIT_MS 50
+
+#define DT_DRV_COMPAT bosch_bme280
+
+#define ESS_SENSORS_COUNT DT_NUM_INST_STATUS_OKAY(DT_DRV_COMPAT)
+#define ESS_SENSOR_FRAME_SIZE 32
+
+BUILD_ASSERT(ESS_SENSORS_COUNT > 0, "No BME280 sensor enabled in the devicetree");
+BUILD_ASSERT(ESS_SENSOR_FRAME_SIZE <= BUFFER_POOL_BLOCK_SIZE, "The sensor frames are taken from the buffer pool");
+BUILD_ASSERT(ESS_SENSORS_COUNT == BUFFER_POOL_ESS_FRAME_BLOCKS, "The buffer pool holds one frame per sensor");
+
+#define ESS_CHANNEL_TEMPERATURE 0
+#define ESS_CHANNEL_PRESSURE 1
+#define ESS_CHANNEL_HUMIDITY 2
+
+/*
+ * Channels of every sensor:
+ * kind, characteristic UUID, decoder channel, decimal scale of the value, decimal scale of the record value,
+ * CPF exponent, CPF unit, name
+ */
+#define ESS_CHANNEL_KINDS(fn, inst)                                                                               \
+    fn(inst, ESS_CHANNEL_TEMPERATURE, BT_UUID_TEMPERATURE, SENSOR_CHAN_AMBIENT_TEMP, 2, 2, -2,                    \
+       0x272F /* Degree Celsius */, "Temperature")                                                                \
+    fn(inst, ESS_CHANNEL_PRESSURE, BT_UUID_PRESSURE, SENSOR_CHAN_PRESS, 1, 4, 2,                                  \
+       0x2724 /* Pascal (1 hPa = 100 Pa) */, "Pressure")                                                          \
+    fn(inst, ESS_CHANNEL_HUMIDITY, BT_UUID_HUMIDITY, SENSOR_CHAN_HUMIDITY, 2, 2, -2, 0x2A6F /* Humidity */,       \
+       "Humidity")
+
+#define ESS_CHANNEL_KINDS_COUNT 3
+#define ESS_CHANNELS_COUNT (ESS_SENSORS_COUNT * ESS_CHANNEL_KINDS_COUNT)
+#define ESS_CHANNEL_INDEX(inst, kind) ((inst) * ESS_CHANNEL_KINDS_COUNT + (kind))
+
+// The first sensor keeps the "outside" description, the others are numbered "second", "third", ...
+#define ESS_CPF_DESCRIPTION(inst) ((inst) == 0 ? 0x010C : (inst) + 1)
+
+struct ess_sensor {
+    const struct device *dev;
+    struct rtio_iodev *iodev;
+    // Taken from the buffer pool between the read and the decoding
+    uint8_t *frame;
+    bool is_ready;
+    bool is_sampled;
+    uint16_t sequence;
+    int64_t timestamp_ms;
+    uint8_t record[ESS_RECORD_SIZE];
+};
 
-LOG_MODULE_REGISTER(environmental_service, LOG_LEVEL_INF);
+struct ess_channel {
+    uint8_t sensor;
+    struct sensor_chan_spec spec;
+    uint8_t pow;
+    uint8_t record_pow;
+    const char *name;
+    int16_t value;
+    int32_t record_value;
+};
 
-#define SAMPLING_INTERVAL_MS 15000
+#define ESS_SENSOR_IODEV_DEFINE(inst)                                                                        \
+    SENSOR_DT_READ_IODEV(ess_iodev_##inst, DT_DRV_INST(inst), {SENSOR_CHAN_AMBIENT_TEMP, 0},                 \
+                         {SENSOR_CHAN_HUMIDITY, 0}, {SENSOR_CHAN_PRESS, 0});
 
-const struct device *const bme280_dev = DEVICE_DT_GET(DT_NODELABEL(bme280_dev));
+DT_INST_FOREACH_STATUS_OKAY(ESS_SENSOR_IODEV_DEFINE)
 
-SENSOR_DT_READ_IODEV(bme280_iodev, DT_NODELABEL(bme280_dev), {SENSOR_CHAN_AMBIENT_TEMP, 0}, {SENSOR_CHAN_HUMIDITY, 0},
-                     {SENSOR_CHAN_PRESS, 0});
+// All the sensors are read with a single batch of requests
+RTIO_DEFINE(ess_ctx, ESS_SENSORS_COUNT, ESS_SENSORS_COUNT);
 
-RTIO_DEFINE(bme280_ctx, 1, 1);
+#define ESS_SENSOR_INIT(inst) [inst] = {.dev = DEVICE_DT_INST_GET(inst), .iodev = &ess_iodev_##inst},
 
-const struct sensor_decoder_api *decoder;
-static struct k_work_delayable sample_periodic_work;
+static struct ess_sensor sensors[ESS_SENSORS_COUNT] = {DT_INST_FOREACH_STATUS_OKAY(ESS_SENSOR_INIT)};
 
-#define SENSOR_VAL_FORMAT(val) (val / 100), abs(val) % 100
+#define ESS_CHANNEL_INIT(inst, kind, uuid, chan, _pow, _record_pow, exp, unit, _name)                        \
+    [ESS_CHANNEL_INDEX(inst, kind)] = {                                                                      \
+        .sensor = inst, .spec = {chan, 0}, .pow = _pow, .record_pow = _record_pow, .name = _name},
+#define ESS_SENSOR_CHANNELS_INIT(inst) ESS_CHANNEL_KINDS(ESS_CHANNEL_INIT, inst)
 
-static const struct bt_gatt_cpf temperature_att_format_cpf = {
-    .format = 0x0E, /* sint16 */
-    .exponent = -2,
-    .unit = 0x272F,        /* Degree Celsius */
-    .name_space = 0x01,    /* Bluetooth SIG */
-    .description = 0x010C, /* "outside" */
-};
+static struct ess_channel channels[ESS_CHANNELS_COUNT] = {DT_INST_FOREACH_STATUS_OKAY(ESS_SENSOR_CHANNELS_INIT)};
 
-static const struct bt_gatt_cpf pressure_att_format_cpf = {
-    .format = 0x0E, /* sint16 */
-    .exponent = 2,
-    .unit = 0x2724,        /* Pascal (1 hPa = 100 Pa) */
-    .name_space = 0x01,    /* Bluetooth SIG */
-    .description = 0x010C, /* "outside" */
-};
+#define ESS_CHANNEL_CPF_INIT(inst, kind, uuid, chan, pow, record_pow, exp, _unit, name) \
+    [ESS_CHANNEL_INDEX(inst, kind)] = {                                     \
+        .format = 0x0E, /* sint16 */                                        \
+        .exponent = exp,                                                    \
+        .unit = _unit,                                                      \
+        .name_space = 0x01, /* Bluetooth SIG */                             \
+        .description = ESS_CPF_DESCRIPTION(inst),                           \
+    },
+#define ESS_SENSOR_CPFS_INIT(inst) ESS_CHANNEL_KINDS(ESS_CHANNEL_CPF_INIT, inst)
 
-static const struct bt_gatt_cpf humidity_att_format_cpf = {
-    .format = 0x0E, /* sint16 */
-    .exponent = -2,
-    .unit = 0x2A6F,        /* Humidity */
-    .name_space = 0x01,    /* Bluetooth SIG */
-    .description = 0x010C, /* "outside" */
-};
+static const struct bt_gatt_cpf channel_cpfs[ESS_CHANNELS_COUNT] = {DT_INST_FOREACH_STATUS_OKAY(ESS_SENSOR_CPFS_INIT)};
 
-static ssize_t read_temperature(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                                uint16_t offset);
-static ssize_t read_pressure(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                             uint16_t offset);
-static ssize_t read_humidity(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                             uint16_t offset);
-static void blvl_ccc_temperature_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
-static void blvl_ccc_pressure_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
-static void blvl_ccc_humidity_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static struct k_work_delayable sample_periodic_work;
+static struct k_work notify_latest_work;
+static struct k_work save_elevation_work;
+static struct k_work read_sample_work;
+
+// Uptime of the link encryption per connection, cleared by the first notification to measure the reconnect time
+static int64_t secured_at_ms[CONFIG_BT_MAX_CONN];
+// Uptime of the last sample log
+static int64_t sample_logged_at_ms;
+// 32-bit uptime of the last successful sample, checked by the reads without the sample mutex
+static atomic_t sampled_at_ms = ATOMIC_INIT(0);
+static uint32_t sampling_interval_ms = SAMPLING_INTERVAL_MS;
+
+// Serializes the periodic and the on-read samples
+static K_MUTEX_DEFINE(sample_mut);
+// Given once the sample asked for by a read is done
+static K_SEM_DEFINE(read_sample_sem, 0, 1);
+
+#define SENSOR_VAL_FORMAT(val) (val / 100), abs(val) % 100
 
+static ssize_t read_channel(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                            uint16_t offset);
+static void channel_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static ssize_t read_record(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                           uint16_t offset);
+static void record_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static ssize_t read_derived(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                            uint16_t offset);
+static void derived_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static ssize_t read_pressure_trend(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                   uint16_t offset);
+static void pressure_trend_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static ssize_t read_reference_elevation(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+                                        uint16_t len, uint16_t offset);
+static ssize_t write_reference_elevation(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+                                         uint16_t len, uint16_t offset, uint8_t flags);
+
+#define DERIVED_DEW_POINT 0
+#define DERIVED_ELEVATION 1
+#define DERIVED_SEA_LEVEL_PRESSURE 2
+#define DERIVED_COUNT 3
+
+/*
+ * Metrics derived from the first sensor: Dew Point (sint8, DegC), Elevation (sint24, 0.01 m, pressure
+ * altitude) and sea level Pressure (uint32, 0.1 Pa, at the reference elevation). Encoded once per sample.
+ */
+static uint8_t derived_values[DERIVED_COUNT][sizeof(uint32_t)];
+static const uint8_t derived_sizes[DERIVED_COUNT] = {sizeof(int8_t), 3, sizeof(uint32_t)};
+static const uint8_t derived_indexes[DERIVED_COUNT] = {DERIVED_DEW_POINT, DERIVED_ELEVATION,
+                                                       DERIVED_SEA_LEVEL_PRESSURE};
+static const struct bt_gatt_attr *derived_attrs[DERIVED_COUNT];
+
+// Elevation of the first sensor in 0.01 m, for the sea level pressure
+static int32_t reference_elevation = 0;
+
+#define ESS_DERIVED_ATTRS(uuid, index)                                                                             \
+    BT_GATT_CHARACTERISTIC(uuid, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_READ, read_derived, NULL,    \
+                           (void *)&derived_indexes[index]),                                                      \
+        BT_GATT_CCC(derived_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
+
+#define ESS_CHANNEL_ATTRS(inst, kind, uuid, chan, pow, record_pow, exp, unit, name)                            \
+    BT_GATT_CHARACTERISTIC(uuid, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_READ, read_channel, NULL, \
+                           &channels[ESS_CHANNEL_INDEX(inst, kind)]),                                           \
+        BT_GATT_CCC(channel_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),                          \
+        BT_GATT_CPF(&channel_cpfs[ESS_CHANNEL_INDEX(inst, kind)]),
+#define ESS_RECORD_ATTRS(inst)                                                                                    \
+    BT_GATT_CHARACTERISTIC(BT_UUID_ESS_RECORD, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_READ,         \
+                           read_record, NULL, &sensors[inst]),                                                    \
+        BT_GATT_CCC(record_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+#define ESS_SENSOR_ATTRS(inst) ESS_CHANNEL_KINDS(ESS_CHANNEL_ATTRS, inst) ESS_RECORD_ATTRS(inst)
+
+// The sensors' attributes end with a comma, so the derived ones follow them directly
 BT_GATT_SERVICE_DEFINE(ess_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_ESS),
-                       BT_GATT_CHARACTERISTIC(BT_UUID_TEMPERATURE, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-                                              BT_GATT_PERM_READ, read_temperature, NULL, NULL),
-                       BT_GATT_CCC(blvl_ccc_temperature_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
-                       BT_GATT_CPF(&temperature_att_format_cpf),
-                       BT_GATT_CHARACTERISTIC(BT_UUID_PRESSURE, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-                                              BT_GATT_PERM_READ, read_pressure, NULL, NULL),
-                       BT_GATT_CCC(blvl_ccc_pressure_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
-                       BT_GATT_CPF(&pressure_att_format_cpf),
-                       BT_GATT_CHARACTERISTIC(BT_UUID_HUMIDITY, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-                                              BT_GATT_PERM_READ, read_humidity, NULL, NULL),
-                       BT_GATT_CCC(blvl_ccc_humidity_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
-                       BT_GATT_CPF(&humidity_att_format_cpf), );
+                       DT_INST_FOREACH_STATUS_OKAY(ESS_SENSOR_ATTRS)
+                       ESS_DERIVED_ATTRS(BT_UUID_DEW_POINT, DERIVED_DEW_POINT),
+                       ESS_DERIVED_ATTRS(BT_UUID_ELEVATION, DERIVED_ELEVATION),
+                       ESS_DERIVED_ATTRS(BT_UUID_PRESSURE, DERIVED_SEA_LEVEL_PRESSURE),
+                       BT_GATT_CUD("Sea Level Pressure", BT_GATT_PERM_READ),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_ESS_REFERENCE_ELEVATION, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                                              BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_ENCRYPT, read_reference_elevation,
+                                              write_reference_elevation, NULL),
+                       BT_GATT_CUD("Reference Elevation", BT_GATT_PERM_READ),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_ESS_PRESSURE_TREND, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                                              BT_GATT_PERM_READ, read_pressure_trend, NULL, NULL),
+                       BT_GATT_CCC(pressure_trend_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+                       BT_GATT_CUD("Pressure Trend", BT_GATT_PERM_READ), );
+
+// The Pressure Trend characteristic value attribute, notified only when the category changes
+static const struct bt_gatt_attr *pressure_trend_attr;
+
+// Characteristic value attributes of the channels, for the notifications
+static const struct bt_gatt_attr *channel_attrs[ESS_CHANNELS_COUNT];
+// Characteristic value attributes of the sensors' records
+static const struct bt_gatt_attr *record_attrs[ESS_SENSORS_COUNT];
+
+static const int32_t decimal_scales[] = {1, 10, 100, 1000, 10000};
+
+// Rounded value * 10^pow of the q31 reading, value = q31 * 2^(shift - 31)
+static int32_t sensor_q31_data_to_scaled(const struct sensor_q31_data *data, uint8_t pow)
+{
+    int64_t value = (int64_t)data->readings[0].value * decimal_scales[pow];
+    int8_t shift = 31 - data->shift;
 
-static int16_t temperature = 0;
-static int16_t pressure = 0;
-static int16_t humidity = 0;
+    if (shift <= 0) {
+        return value << -shift;
+    }
+    return (value + (1LL << (shift - 1))) >> shift;
+}
 
-static int16_t sensor_q31_data_to_int16_attr(struct sensor_q31_data *data, uint8_t pow)
+static void update_record(size_t index)
 {
-    float32_t v = data->readings[0].value;
-    int8_t s = data->shift;
+    struct ess_sensor *sensor = &sensors[index];
+    uint8_t *record = sensor->record;
+    uint64_t timestamp_ms;
+    uint8_t flags = 0;
+
+    if (!device_clock_from_uptime(sensor->timestamp_ms, &timestamp_ms)) {
+        flags |= ESS_RECORD_FLAG_SYNCED;
+    } else {
+        timestamp_ms = sensor->timestamp_ms;
+    }
 
-    return v / (1 << (31 - s)) * powf(10.0f, (float32_t)pow);
+    record[0] = ESS_RECORD_VERSION;
+    record[1] = flags;
+    sys_put_le16(sensor->sequence, &record[2]);
+    sys_put_le48(timestamp_ms, &record[4]);
+    sys_put_le16(channels[ESS_CHANNEL_INDEX(index, ESS_CHANNEL_TEMPERATURE)].record_value, &record[10]);
+    sys_put_le32(channels[ESS_CHANNEL_INDEX(index, ESS_CHANNEL_PRESSURE)].record_value, &record[12]);
+    sys_put_le16(channels[ESS_CHANNEL_INDEX(index, ESS_CHANNEL_HUMIDITY)].record_value, &record[16]);
 }
 
-static void sample_periodic_handler(struct k_work *work)
+static void release_frame(struct ess_sensor *sensor)
 {
-    uint8_t buff[32];
-    uint32_t temp_fit = 0;
-    uint32_t press_fit = 0;
-    uint32_t hum_fit = 0;
-    struct sensor_q31_data temp_data = {0};
-    struct sensor_q31_data press_data = {0};
-    struct sensor_q31_data hum_data = {0};
+    if (sensor->frame) {
+        buffer_pool_free(BUFFER_POOL_USER_ESS_FRAME, sensor->frame);
+        sensor->frame = NULL;
+    }
+}
+
+static int read_sensors(void)
+{
+    uint32_t submitted = 0;
     int err;
 
-    err = sensor_read(&bme280_iodev, &bme280_ctx, buff, sizeof(buff));
-    if (err) {
-        LOG_ERR("Failed to read the sensor data (error %d)", err);
-        goto reschedule;
+    for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+        if (!sensors[i].is_ready) {
+            continue;
+        }
+
+        sensors[i].frame = buffer_pool_alloc(BUFFER_POOL_USER_ESS_FRAME);
+        if (sensors[i].frame == NULL) {
+            LOG_WRN("No buffer for the sensor %zu frame", i);
+            sensors[i].is_sampled = false;
+            continue;
+        }
+
+        struct rtio_sqe *sqe = rtio_sqe_acquire(&ess_ctx);
+        if (sqe == NULL) {
+            LOG_WRN("No submission queue entry left for the sensor %zu", i);
+            release_frame(&sensors[i]);
+            // The sensors not submitted keep no value from an earlier sample, sample() would decode a NULL frame
+            for (size_t j = i; j < ESS_SENSORS_COUNT; j++) {
+                sensors[j].is_sampled = false;
+            }
+            break;
+        }
+
+        rtio_sqe_prep_read(sqe, sensors[i].iodev, RTIO_PRIO_NORM, sensors[i].frame, ESS_SENSOR_FRAME_SIZE,
+                           &sensors[i]);
+        submitted++;
     }
 
-    err = sensor_get_decoder(bme280_dev, &decoder);
+    if (submitted == 0) {
+        return -ENODEV;
+    }
+
+    TRACE_POINT("ess_read_submit", submitted, 0);
+    err = rtio_submit(&ess_ctx, submitted);
     if (err) {
-        LOG_ERR("Failed to get the sensor's decoder API (error %d)", err);
-        goto reschedule;
+        LOG_ERR("Failed to submit the sensors read (error %d)", err);
+
+        // Only the completions already posted are consumed, waiting for the others could block forever
+        struct rtio_cqe *cqe;
+        while ((cqe = rtio_cqe_consume(&ess_ctx)) != NULL) {
+            rtio_cqe_release(&ess_ctx, cqe);
+        }
+        for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+            if (sensors[i].frame) {
+                sensors[i].is_sampled = false;
+            }
+        }
+        return err;
     }
 
-    decoder->decode(buff, (struct sensor_chan_spec){SENSOR_CHAN_AMBIENT_TEMP, 0}, &temp_fit, 1, &temp_data);
-    decoder->decode(buff, (struct sensor_chan_spec){SENSOR_CHAN_PRESS, 0}, &press_fit, 1, &press_data);
-    decoder->decode(buff, (struct sensor_chan_spec){SENSOR_CHAN_HUMIDITY, 0}, &hum_fit, 1, &hum_data);
+    for (uint32_t i = 0; i < submitted; i++) {
+        struct rtio_cqe *cqe = rtio_cqe_consume_block(&ess_ctx);
+        struct ess_sensor *sensor = cqe->userdata;
 
-    temperature = sensor_q31_data_to_int16_attr(&temp_data, 2);
-    pressure = sensor_q31_data_to_int16_attr(&press_data, 1);
-    humidity = sensor_q31_data_to_int16_attr(&hum_data, 2);
+        TRACE_POINT("ess_read_done", sensor - sensors, cqe->result);
 
-    bt_gatt_notify(NULL, &ess_service.attrs[2], &temperature, sizeof(temperature));
-    bt_gatt_notify(NULL, &ess_service.attrs[6], &pressure, sizeof(pressure));
-    bt_gatt_notify(NULL, &ess_service.attrs[10], &humidity, sizeof(humidity));
+        if (cqe->result < 0) {
+            LOG_ERR("Failed to read the sensor %u data (error %d)", (unsigned int)(sensor - sensors), cqe->result);
+            sensor->is_sampled = false;
+            err = cqe->result;
+        } else {
+            sensor->is_sampled = true;
+        }
 
-    LOG_INF("Temp: %i.%02i DegC; Press: %i hPa; Humidity: %i.%02i %%RH", SENSOR_VAL_FORMAT(temperature), pressure,
-            SENSOR_VAL_FORMAT(humidity));
+        rtio_cqe_release(&ess_ctx, cqe);
+    }
 
-reschedule:
-    k_work_reschedule(&sample_periodic_work, K_MSEC(SAMPLING_INTERVAL_MS));
+    return err;
 }
 
-static ssize_t read_temperature(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                                uint16_t offset)
+static void update_derived(void)
 {
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &temperature, sizeof(temperature));
+    int32_t temperature = channels[ESS_CHANNEL_INDEX(0, ESS_CHANNEL_TEMPERATURE)].record_value;
+    uint32_t pressure = MAX(channels[ESS_CHANNEL_INDEX(0, ESS_CHANNEL_PRESSURE)].record_value, 1);
+    uint32_t humidity = MAX(channels[ESS_CHANNEL_INDEX(0, ESS_CHANNEL_HUMIDITY)].record_value, 1);
+
+    int32_t dew_point = derived_metrics_dew_point(temperature, humidity);
+    derived_values[DERIVED_DEW_POINT][0] = CLAMP(DIV_ROUND_CLOSEST(dew_point, 100), INT8_MIN, INT8_MAX);
+    sys_put_le24(derived_metrics_pressure_altitude(pressure), derived_values[DERIVED_ELEVATION]);
+    sys_put_le32(derived_metrics_sea_level_pressure(pressure, reference_elevation),
+                 derived_values[DERIVED_SEA_LEVEL_PRESSURE]);
 }
 
-static ssize_t read_pressure(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                             uint16_t offset)
+static void pressure_trend_encode(uint8_t *data)
 {
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &pressure, sizeof(pressure));
+    struct pressure_trend trend;
+
+    pressure_trend_get(&trend);
+
+    sys_put_le16(trend.slope_1h, &data[0]);
+    sys_put_le16(trend.slope_3h, &data[2]);
+    data[4] = trend.tendency;
+    data[5] = trend.forecast;
 }
 
-static ssize_t read_humidity(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
-                             uint16_t offset)
+static void update_pressure_trend(void)
 {
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &humidity, sizeof(humidity));
+    uint32_t pressure = channels[ESS_CHANNEL_INDEX(0, ESS_CHANNEL_PRESSURE)].record_value;
+    uint32_t sea_level_pressure = sys_get_le32(derived_values[DERIVED_SEA_LEVEL_PRESSURE]);
+    uint8_t data[ESS_PRESSURE_TREND_SIZE];
+
+    if (!pressure_trend_update(sensors[0].timestamp_ms, pressure, sea_level_pressure)) {
+        return;
+    }
+
+    pressure_trend_encode(data);
+    LOG_INF("Pressure tendency %u, forecast %u", data[4], data[5]);
+    notification_dispatcher_submit(pressure_trend_attr, data, sizeof(data));
 }
 
-static void blvl_ccc_temperature_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static int sample(void)
 {
-    ARG_UNUSED(attr);
+    const struct sensor_decoder_api *decoder;
+    int err;
+
+    k_mutex_lock(&sample_mut, K_FOREVER);
+
+    err = read_sensors();
+    if (err == -ENODEV) {
+        k_mutex_unlock(&sample_mut);
+        return err;
+    }
+    // After a failed conversion the values stay stale, so the next read asks for a sample again
+    if (!err) {
+        atomic_set(&sampled_at_ms, k_uptime_get_32());
+    }
+
+    for (size_t i = 0; i < ESS_CHANNELS_COUNT; i++) {
+        struct ess_channel *channel = &channels[i];
+        struct ess_sensor *sensor = &sensors[channel->sensor];
+        struct sensor_q31_data data = {0};
+        uint32_t fit = 0;
+
+        if (!sensor->is_sampled) {
+            continue;
+        }
+
+        err = sensor_get_decoder(sensor->dev, &decoder);
+        if (err) {
+            LOG_ERR("Failed to get the sensor's decoder API (error %d)", err);
+            continue;
+        }
+
+        if (decoder->decode(sensor->frame, channel->spec, &fit, 1, &data) <= 0) {
+            continue;
+        }
+
+        channel->value = sensor_q31_data_to_scaled(&data, channel->pow);
+        channel->record_value = sensor_q31_data_to_scaled(&data, channel->record_pow);
+        // All the channels of a sensor come from the same conversion
+        sensor->timestamp_ms = data.header.base_timestamp_ns / NSEC_PER_MSEC;
+    }
+
+    for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+        release_frame(&sensors[i]);
+    }
+
+    bool log_sample = log_ratelimit_allow(&sample_logged_at_ms, SAMPLE_LOG_INTERVAL_MS);
+
+    for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+        if (!sensors[i].is_sampled) {
+            continue;
+        }
+
+        int16_t temperature = channels[ESS_CHANNEL_INDEX(i, ESS_CHANNEL_TEMPERATURE)].value;
+        int16_t pressure = channels[ESS_CHANNEL_INDEX(i, ESS_CHANNEL_PRESSURE)].value;
+        int16_t humidity = channels[ESS_CHANNEL_INDEX(i, ESS_CHANNEL_HUMIDITY)].value;
+
+        sensors[i].sequence++;
+        update_record(i);
+
+        if (i == 0) {
+            advertising_update_environment(temperature, humidity, pressure);
+        }
+
+        if (!log_sample) {
+            continue;
+        }
+
+        LOG_INF("Sensor %zu Temp: %i.%02i DegC; Press: %i hPa; Humidity: %i.%02i %%RH", i,
+                SENSOR_VAL_FORMAT(temperature), pressure, SENSOR_VAL_FORMAT(humidity));
+    }
+
+    if (sensors[0].is_sampled) {
+        update_derived();
+        update_pressure_trend();
+    }
+
+    k_mutex_unlock(&sample_mut);
+    return 0;
+}
+
+static bool is_stale(void)
+{
+    return (uint32_t)(k_uptime_get_32() - (uint32_t)atomic_get(&sampled_at_ms)) > READ_MAX_AGE_MS;
+}
+
+static void log_first_notification(struct bt_conn *conn, void *user_data)
+{
+    int64_t *secured_at = &secured_at_ms[bt_conn_index(conn)];
+
+    // Centrals which have not subscribed yet keep waiting for their first notification
+    if (*secured_at == 0 || !bt_gatt_is_subscribed(conn, channel_attrs[0], BT_GATT_CCC_NOTIFY)) {
+        return;
+    }
+
+    LOG_INF("First notification %lld ms after the link encryption", k_uptime_get() - *secured_at);
+    *secured_at = 0;
+}
+
+static void notify_channels(void)
+{
+    for (size_t i = 0; i < ESS_CHANNELS_COUNT; i++) {
+        if (sensors[channels[i].sensor].is_sampled) {
+            notification_dispatcher_submit(channel_attrs[i], &channels[i].value, sizeof(channels[i].value));
+        }
+    }
+
+    for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+        if (sensors[i].is_sampled) {
+            notification_dispatcher_submit(record_attrs[i], sensors[i].record, sizeof(sensors[i].record));
+        }
+    }
+
+    if (sensors[0].is_sampled) {
+        for (size_t i = 0; i < DERIVED_COUNT; i++) {
+            notification_dispatcher_submit(derived_attrs[i], derived_values[i], derived_sizes[i]);
+        }
+    }
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, log_first_notification, NULL);
+}
+
+static void sample_periodic_handler(struct k_work *work)
+{
+    TRACE_POINT("ess_sample_begin", 0, 0);
+
+    if (!sample()) {
+        notify_channels();
+    }
+
+    TRACE_POINT("ess_sample_end", 0, 0);
+
+    k_work_reschedule(&sample_periodic_work, K_MSEC(sampling_interval_ms));
+}
+
+static void read_sample_handler(struct k_work *work)
+{
+    // A periodic sample may have refreshed the values since the read asked for it
+    if (is_stale()) {
+        TRACE_POINT("ess_read_sample", 0, 0);
+        if (!sample()) {
+            notify_channels();
+        }
+    }
+
+    k_sem_give(&read_sample_sem);
+}
+
+/*
+ * The conversion runs on the system workqueue, a read in the Bluetooth RX thread waits for it at most
+ * READ_SAMPLE_WAIT_MS and returns the values it has after that. The reads arriving while a sample is
+ * in progress share it.
+ */
+static void sample_if_stale(void)
+{
+    if (READ_MAX_AGE_MS == 0 || !is_stale()) {
+        return;
+    }
+
+    k_sem_reset(&read_sample_sem);
+    k_work_submit(&read_sample_work);
+
+    if (k_sem_take(&read_sample_sem, K_MSEC(READ_SAMPLE_WAIT_MS))) {
+        LOG_DBG("Fresh sample not ready, the read returns the previous values");
+    }
+}
+
+static void notify_latest_handler(struct k_work *work)
+{
+    TRACE_POINT("ess_notify_latest", 0, 0);
+    notify_channels();
+}
+
+static void ess_security_changed(struct bt_conn *conn, bt_security_t level, enum bt_security_err err)
+{
+    if (!err && level >= BT_SECURITY_L2) {
+        secured_at_ms[bt_conn_index(conn)] = k_uptime_get();
+    }
+}
+
+static void ess_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    secured_at_ms[bt_conn_index(conn)] = 0;
+}
+
+BT_CONN_CB_DEFINE(ess_conn_callbacks) = {
+    .security_changed = ess_security_changed,
+    .disconnected = ess_disconnected,
+};
+
+static ssize_t read_channel(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                            uint16_t offset)
+{
+    const struct ess_channel *channel = attr->user_data;
+    uint32_t started_at = gatt_stats_begin();
+
+    // The following parts of a long read keep the values of the first one
+    if (offset == 0) {
+        sample_if_stale();
+    }
+
+    ssize_t ret = bt_gatt_attr_read(conn, attr, buf, len, offset, &channel->value, sizeof(channel->value));
+    gatt_stats_end(GATT_STATS_OP_READ, started_at, ret < 0);
+
+    return ret;
+}
+
+static void channel_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    // The CCC descriptor follows the characteristic value attribute
+    const struct ess_channel *channel = (attr - 1)->user_data;
+    uint32_t started_at = gatt_stats_begin();
     bool enabled = (value == BT_GATT_CCC_NOTIFY);
-    LOG_INF("Temperature notifications %s", enabled ? "enabled" : "disabled");
+    LOG_INF("Sensor %u %s notifications %s", channel->sensor, channel->name, enabled ? "enabled" : "disabled");
+
+    // Bonded peers get their CCC restored on encryption, send them the data right away
+    if (enabled) {
+        k_work_submit(&notify_latest_work);
+    }
+
+    gatt_stats_end(GATT_STATS_OP_CCC, started_at, false);
 }
 
-static void blvl_ccc_pressure_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static ssize_t read_record(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                           uint16_t offset)
+{
+    const struct ess_sensor *sensor = attr->user_data;
+    uint32_t started_at = gatt_stats_begin();
+
+    if (offset == 0) {
+        sample_if_stale();
+    }
+
+    ssize_t ret = bt_gatt_attr_read(conn, attr, buf, len, offset, sensor->record, sizeof(sensor->record));
+    gatt_stats_end(GATT_STATS_OP_READ, started_at, ret < 0);
+
+    return ret;
+}
+
+static void record_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    const struct ess_sensor *sensor = (attr - 1)->user_data;
+    bool enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Sensor %u record notifications %s", (unsigned int)(sensor - sensors), enabled ? "enabled" : "disabled");
+
+    if (enabled) {
+        k_work_submit(&notify_latest_work);
+    }
+}
+
+static ssize_t read_derived(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                            uint16_t offset)
+{
+    uint8_t index = *(const uint8_t *)attr->user_data;
+    uint32_t started_at = gatt_stats_begin();
+
+    if (offset == 0) {
+        sample_if_stale();
+    }
+
+    ssize_t ret = bt_gatt_attr_read(conn, attr, buf, len, offset, derived_values[index], derived_sizes[index]);
+    gatt_stats_end(GATT_STATS_OP_READ, started_at, ret < 0);
+
+    return ret;
+}
+
+static void derived_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
-    ARG_UNUSED(attr);
     bool enabled = (value == BT_GATT_CCC_NOTIFY);
-    LOG_INF("Pressure notifications %s", enabled ? "enabled" : "disabled");
+    LOG_INF("Derived metric %u notifications %s", *(const uint8_t *)(attr - 1)->user_data,
+            enabled ? "enabled" : "disabled");
+
+    if (enabled) {
+        k_work_submit(&notify_latest_work);
+    }
+}
+
+static ssize_t read_pressure_trend(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                                   uint16_t offset)
+{
+    uint8_t data[ESS_PRESSURE_TREND_SIZE];
+
+    pressure_trend_encode(data);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
 }
 
-static void blvl_ccc_humidity_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static void pressure_trend_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
     ARG_UNUSED(attr);
     bool enabled = (value == BT_GATT_CCC_NOTIFY);
-    LOG_INF("Humidity notifications %s", enabled ? "enabled" : "disabled");
+    LOG_INF("Pressure trend notifications %s", enabled ? "enabled" : "disabled");
+}
+
+static ssize_t read_reference_elevation(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+                                        uint16_t len, uint16_t offset)
+{
+    uint8_t data[3];
+
+    sys_put_le24(reference_elevation, data);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, data, sizeof(data));
+}
+
+static ssize_t write_reference_elevation(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+                                         uint16_t len, uint16_t offset, uint8_t flags)
+{
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len != 3) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    int32_t elevation = sign_extend(sys_get_le24(buf), 23);
+    if (elevation < DERIVED_METRICS_ELEVATION_MIN || elevation > DERIVED_METRICS_ELEVATION_MAX) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    k_mutex_lock(&sample_mut, K_FOREVER);
+    reference_elevation = elevation;
+    if (sensors[0].is_sampled) {
+        update_derived();
+    }
+    k_mutex_unlock(&sample_mut);
+
+    LOG_INF("Reference elevation set to %d cm", elevation);
+    // The flash write may take a while, not from the Bluetooth RX thread
+    k_work_submit(&save_elevation_work);
+    k_work_submit(&notify_latest_work);
+
+    return len;
 }
 
+static void save_elevation_handler(struct k_work *work)
+{
+    k_mutex_lock(&sample_mut, K_FOREVER);
+    int32_t elevation = reference_elevation;
+    k_mutex_unlock(&sample_mut);
+
+    int err = settings_save_one("ess/elevation", &elevation, sizeof(elevation));
+    if (err) {
+        LOG_WRN("Failed to store the reference elevation (err %d)", err);
+    }
+}
+
+static int ess_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    if (!settings_name_steq(name, "elevation", NULL) || len != sizeof(reference_elevation)) {
+        return -ENOENT;
+    }
+
+    int rc = read_cb(cb_arg, &reference_elevation, sizeof(reference_elevation));
+    return rc < 0 ? rc : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(ess, "ess", NULL, ess_settings_set, NULL, NULL);
+
 int environmental_service_start(void)
 {
-    if (bme280_dev == NULL) {
-        LOG_ERR("No BME280 device found");
-        return -ENXIO;
+    size_t ready_count = 0;
+
+    for (size_t i = 0; i < ESS_SENSORS_COUNT; i++) {
+        sensors[i].is_ready = device_is_ready(sensors[i].dev);
+        if (!sensors[i].is_ready) {
+            LOG_ERR("BME280 device %s is not ready", sensors[i].dev->name);
+            continue;
+        }
+        ready_count++;
     }
 
-    if (!device_is_ready(bme280_dev)) {
-        LOG_ERR("BME280 device is not ready");
+    if (ready_count == 0) {
+        LOG_ERR("No BME280 device is ready");
         return -EIO;
     }
 
+    for (size_t i = 0; i < ess_service.attr_count; i++) {
+        const struct bt_gatt_attr *attr = &ess_service.attrs[i];
+        if (attr->read == read_channel) {
+            channel_attrs[(const struct ess_channel *)attr->user_data - channels] = attr;
+        } else if (attr->read == read_record) {
+            record_attrs[(const struct ess_sensor *)attr->user_data - sensors] = attr;
+        } else if (attr->read == read_derived) {
+            derived_attrs[*(const uint8_t *)attr->user_data] = attr;
+        } else if (attr->read == read_pressure_trend) {
+            pressure_trend_attr = attr;
+        }
+    }
+
+    k_work_init(&notify_latest_work, notify_latest_handler);
+    k_work_init(&save_elevation_work, save_elevation_handler);
+    k_work_init(&read_sample_work, read_sample_handler);
     k_work_init_delayable(&sample_periodic_work, sample_periodic_handler);
-    k_work_schedule(&sample_periodic_work, K_MSEC(SAMPLING_INTERVAL_MS));
+
+    // The first sample is taken right away, so the advertising starts with valid values
+    sample();
+    k_work_schedule(&sample_periodic_work, K_MSEC(sampling_interval_ms));
 
     return 0;
 }
+
+void environmental_service_set_sampling_interval(uint32_t interval_ms)
+{
+    uint32_t previous_ms = sampling_interval_ms;
+
+    sampling_interval_ms = interval_ms;
+
+    // A shorter interval starts with a fresh sample, a longer one takes effect from the next sample on
+    if (interval_ms < previous_ms) {
+        k_work_reschedule(&sample_periodic_work, K_NO_WAIT);
+    }
+
+    LOG_INF("Sampling interval set to %u ms", interval_ms);
+}
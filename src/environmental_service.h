@@ -1,6 +1,46 @@
 #ifndef __ENVIRONMENTAL_SERVICE_H__
 #define __ENVIRONMENTAL_SERVICE_H__
 
+#include <zephyr/bluetooth/uuid.h>
+
+// Measurement Record Characteristic UUID Value
+#define BT_UUID_ESS_RECORD_VAL BT_UUID_128_ENCODE(0x8e7f0300, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Measurement Record Characteristic
+#define BT_UUID_ESS_RECORD BT_UUID_DECLARE_128(BT_UUID_ESS_RECORD_VAL)
+
+// Reference Elevation Characteristic UUID Value
+#define BT_UUID_ESS_REFERENCE_ELEVATION_VAL BT_UUID_128_ENCODE(0x8e7f0301, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Reference Elevation Characteristic
+#define BT_UUID_ESS_REFERENCE_ELEVATION BT_UUID_DECLARE_128(BT_UUID_ESS_REFERENCE_ELEVATION_VAL)
+
+// Pressure Trend Characteristic UUID Value
+#define BT_UUID_ESS_PRESSURE_TREND_VAL BT_UUID_128_ENCODE(0x8e7f0302, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Pressure Trend Characteristic
+#define BT_UUID_ESS_PRESSURE_TREND BT_UUID_DECLARE_128(BT_UUID_ESS_PRESSURE_TREND_VAL)
+
+/*
+ * Measurement Record layout, little-endian, all the values from the same conversion:
+ * version (uint8), flags (uint8), sequence number (uint16), timestamp (uint48, ms),
+ * temperature (sint16, 0.01 DegC), pressure (uint32, 0.1 Pa), humidity (uint16, 0.01 %RH)
+ *
+ * The timestamp counts from the Unix epoch once the device clock is synchronized (ESS_RECORD_FLAG_SYNCED),
+ * from the boot before.
+ */
+#define ESS_RECORD_VERSION 2
+#define ESS_RECORD_SIZE 18
+#define ESS_RECORD_FLAG_SYNCED BIT(0)
+
+/*
+ * Pressure Trend layout, little-endian: 1 hour and 3 hours slopes (sint16, Pa/h),
+ * tendency (uint8, enum pressure_tendency) and forecast (uint8, enum pressure_forecast)
+ */
+#define ESS_PRESSURE_TREND_SIZE 6
+
 int environmental_service_start(void);
 
-#endif  //__ENVIRONMENTAL_SERVICE_H__
\ No newline at end of file
+/**
+ * @brief Set the periodic sampling interval. A shorter one than the current takes a sample right away.
+ */
+void environmental_service_set_sampling_interval(uint32_t interval_ms);
+
+#endif  //__ENVIRONMENTAL_SERVICE_H__
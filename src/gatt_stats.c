@@ -0,0 +1,97 @@
+#include "gatt_stats.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include "notification_dispatcher.h"
+
+static struct gatt_stats stats[GATT_STATS_OPS_COUNT];
+static struct k_spinlock lock;
+
+void gatt_stats_end(enum gatt_stats_op op, uint32_t started_at, bool failed)
+{
+    uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - started_at);
+    uint8_t bucket = MIN(latency_us ? 31 - __builtin_clz(latency_us) : 0, GATT_STATS_BUCKETS - 1);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    stats[op].count++;
+    if (failed) {
+        stats[op].failed++;
+    }
+    stats[op].max_us = MAX(stats[op].max_us, latency_us);
+    stats[op].histogram[bucket]++;
+
+    k_spin_unlock(&lock, key);
+}
+
+void gatt_stats_get(enum gatt_stats_op op, struct gatt_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = stats[op];
+    k_spin_unlock(&lock, key);
+}
+
+uint32_t gatt_stats_percentile_us(const struct gatt_stats *stats, uint8_t percentile)
+{
+    uint64_t threshold = DIV_ROUND_UP((uint64_t)stats->count * percentile, 100);
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < GATT_STATS_BUCKETS; i++) {
+        cumulative += stats->histogram[i];
+        if (cumulative >= threshold && cumulative > 0) {
+            return BIT(i + 1);
+        }
+    }
+
+    return 0;
+}
+
+void gatt_stats_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    memset(stats, 0, sizeof(stats));
+    k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const op_names[GATT_STATS_OPS_COUNT] = {"read", "write", "ccc"};
+
+static int cmd_gatt_stats_show(const struct shell *sh, size_t argc, char **argv)
+{
+    struct notification_stats notifications;
+    struct gatt_stats op_stats;
+
+    for (size_t op = 0; op < GATT_STATS_OPS_COUNT; op++) {
+        gatt_stats_get(op, &op_stats);
+        shell_print(sh, "%-5s count %u failed %u p50 <%u us p90 <%u us p99 <%u us max %u us", op_names[op],
+                    op_stats.count, op_stats.failed, gatt_stats_percentile_us(&op_stats, 50),
+                    gatt_stats_percentile_us(&op_stats, 90), gatt_stats_percentile_us(&op_stats, 99),
+                    op_stats.max_us);
+    }
+
+    notification_dispatcher_get_stats(&notifications);
+    shell_print(sh, "notify sent %u coalesced %u dropped %u in flight %u (max %u)", notifications.sent,
+                notifications.coalesced, notifications.dropped, notifications.in_flight,
+                notifications.in_flight_max);
+
+    return 0;
+}
+
+static int cmd_gatt_stats_reset(const struct shell *sh, size_t argc, char **argv)
+{
+    gatt_stats_reset();
+    shell_print(sh, "GATT statistics cleared");
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(gatt_stats_cmds,
+                               SHELL_CMD(show, NULL, "Show the GATT operations statistics", cmd_gatt_stats_show),
+                               SHELL_CMD(reset, NULL, "Clear the GATT operations statistics", cmd_gatt_stats_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(gatt_stats, &gatt_stats_cmds, "GATT operations statistics", NULL);
+#endif
@@ -0,0 +1,59 @@
+#ifndef __GATT_STATS_H__
+#define __GATT_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+enum gatt_stats_op {
+    GATT_STATS_OP_READ,
+    GATT_STATS_OP_WRITE,
+    GATT_STATS_OP_CCC,
+    GATT_STATS_OPS_COUNT,
+};
+
+// Latency histogram buckets, bucket i counts the operations of [2^i, 2^(i + 1)) us
+#define GATT_STATS_BUCKETS 16
+
+struct gatt_stats {
+    uint32_t count;
+    uint32_t failed;
+    uint32_t max_us;
+    uint32_t histogram[GATT_STATS_BUCKETS];
+};
+
+/**
+ * @brief Start timing a GATT operation.
+ *
+ * @return Start time to pass to gatt_stats_end.
+ */
+static inline uint32_t gatt_stats_begin(void)
+{
+    return k_cycle_get_32();
+}
+
+/**
+ * @brief Record a GATT operation handled by the attribute callbacks.
+ *
+ * @param[in] op Operation type.
+ * @param[in] started_at Time returned by gatt_stats_begin.
+ * @param[in] failed The operation was rejected with an ATT error.
+ */
+void gatt_stats_end(enum gatt_stats_op op, uint32_t started_at, bool failed);
+
+/**
+ * @brief Get the statistics of the operation type.
+ */
+void gatt_stats_get(enum gatt_stats_op op, struct gatt_stats *stats);
+
+/**
+ * @brief Get the upper bound of the latency percentile in microseconds, from the histogram.
+ */
+uint32_t gatt_stats_percentile_us(const struct gatt_stats *stats, uint8_t percentile);
+
+/**
+ * @brief Clear the statistics of all the operation types.
+ */
+void gatt_stats_reset(void);
+
+#endif  //__GATT_STATS_H__
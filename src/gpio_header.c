@@ -0,0 +1,311 @@
+#include "gpio_header.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/dt-bindings/pinctrl/nrf-pinctrl.h>
+#include <hal/nrf_saadc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+LOG_MODULE_REGISTER(gpio_header, LOG_LEVEL_DBG);
+
+#if !DT_NODE_EXISTS(DT_NODELABEL(xiao_gpio_header))
+#error "Overlay for xiao_gpio_header node not properly defined."
+#endif
+
+#define GPIO_HEADER_NODE DT_NODELABEL(xiao_gpio_header)
+#define GPIO_HEADER_PIN_SPEC(node) GPIO_DT_SPEC_GET(node, gpios)
+
+static const struct gpio_dt_spec pins[] = {DT_FOREACH_CHILD_SEP(GPIO_HEADER_NODE, GPIO_HEADER_PIN_SPEC, (, ))};
+
+#define PINS_COUNT ARRAY_SIZE(pins)
+
+// Absolute nRF pin numbers (port * 32 + pin) of the header pins, resolved through the connector's gpio-map
+#define GPIO_HEADER_PIN_NUMBER(node) (DT_PROP(DT_GPIO_CTLR(node, gpios), port) * 32 + DT_GPIO_PIN(node, gpios))
+
+static const uint8_t pin_numbers[] = {DT_FOREACH_CHILD_SEP(GPIO_HEADER_NODE, GPIO_HEADER_PIN_NUMBER, (, ))};
+
+#define PIN_BIT64(number) ((number) < 64 ? BIT64(number) : 0)
+
+/*
+ * Pins selected by the default pinctrl state of every enabled peripheral (e.g. the BME280 i2c1
+ * on D4/D5 and the console uart0 on D6/D7).
+ */
+#define PSEL_PIN_BIT(node, prop, idx) | PIN_BIT64((DT_PROP_BY_IDX(node, prop, idx) >> NRF_PIN_POS) & NRF_PIN_MSK)
+#define PINCTRL_GROUP_PINS(group) DT_FOREACH_PROP_ELEM(group, psels, PSEL_PIN_BIT)
+#define PERIPHERAL_PINS(node) \
+    IF_ENABLED(DT_PINCTRL_HAS_IDX(node, 0), (DT_FOREACH_CHILD(DT_PINCTRL_BY_IDX(node, 0, 0), PINCTRL_GROUP_PINS)))
+
+// SAADC inputs AIN0-AIN3 are fixed to P0.02-P0.05, AIN4-AIN7 to P0.28-P0.31
+#define SAADC_INPUT_PIN(ain) ((ain) < 4 ? (ain) + 2 : (ain) + 24)
+#define ANALOG_HEADER_PIN_BIT(node) | PIN_BIT64(SAADC_INPUT_PIN(DT_PROP(node, adc_channel) - NRF_SAADC_INPUT_AIN0))
+
+static const uint64_t reserved_pin_numbers = 0 DT_FOREACH_STATUS_OKAY_NODE(PERIPHERAL_PINS)
+    COND_CODE_1(DT_NODE_EXISTS(DT_NODELABEL(xiao_analog_header)),
+                (DT_FOREACH_CHILD(DT_NODELABEL(xiao_analog_header), ANALOG_HEADER_PIN_BIT)), ());
+
+BUILD_ASSERT(PINS_COUNT <= 16, "The header pins have to fit into the 16 bit masks");
+
+static struct gpio_callback pin_callbacks[PINS_COUNT];
+static uint8_t pin_modes[PINS_COUNT];
+
+static uint16_t reserved_mask = 0;
+static uint16_t inputs_mask = 0;
+static uint16_t outputs_mask = 0;
+static uint16_t output_levels = 0;
+static uint16_t debounce_ms = GPIO_HEADER_DEBOUNCE_MS_DEFAULT;
+
+// Edges collected by the interrupt handler until the debounce period elapses
+static atomic_t pending_changed = ATOMIC_INIT(0);
+static atomic_t pending_edges = ATOMIC_INIT(0);
+static atomic_t batch_timestamp_ms = ATOMIC_INIT(0);
+
+static struct k_work_delayable debounce_work;
+static gpio_header_event_callback_t event_callback = NULL;
+
+static K_MUTEX_DEFINE(gpio_header_mut);
+
+static void pin_interrupt_handler(const struct device *port, struct gpio_callback *cb, gpio_port_pins_t port_pins)
+{
+    size_t pin = cb - pin_callbacks;
+
+    // The first edge opens a batch, all the following ones join it until the debounce work runs
+    if (atomic_or(&pending_changed, BIT(pin)) == 0) {
+        atomic_set(&batch_timestamp_ms, k_uptime_get_32());
+    }
+    atomic_inc(&pending_edges);
+
+    // The batch ends one debounce period after its first edge, a continuous pulse train is reported periodically
+    k_work_schedule(&debounce_work, K_MSEC(debounce_ms));
+}
+
+static void debounce_handler(struct k_work *work)
+{
+    struct gpio_header_event event;
+
+    event.timestamp_ms = atomic_get(&batch_timestamp_ms);
+    event.edges = MIN(atomic_clear(&pending_edges), UINT16_MAX);
+    event.changed = atomic_clear(&pending_changed);
+    event.levels = gpio_header_get_levels();
+
+    if (event.changed == 0) {
+        return;
+    }
+
+    LOG_DBG("Header pins changed 0x%04x, levels 0x%04x, %u edges", event.changed, event.levels, event.edges);
+
+    if (event_callback) {
+        event_callback(&event);
+    }
+}
+
+uint8_t gpio_header_pins_count(void)
+{
+    return PINS_COUNT;
+}
+
+uint16_t gpio_header_get_reserved(void)
+{
+    return reserved_mask;
+}
+
+int gpio_header_check_mode(uint8_t pin, uint8_t mode)
+{
+    uint8_t pulls = mode & (GPIO_HEADER_MODE_PULL_UP | GPIO_HEADER_MODE_PULL_DOWN);
+
+    if (pin >= PINS_COUNT || (mode & ~GPIO_HEADER_MODE_VALID_MASK)) {
+        return -EINVAL;
+    }
+
+    switch (mode & GPIO_HEADER_MODE_DIRECTION_MASK) {
+        case GPIO_HEADER_MODE_DISABLED:
+        case GPIO_HEADER_MODE_OUTPUT:
+            if (pulls) {
+                return -EINVAL;
+            }
+            break;
+        case GPIO_HEADER_MODE_INPUT:
+            if (pulls == (GPIO_HEADER_MODE_PULL_UP | GPIO_HEADER_MODE_PULL_DOWN)) {
+                return -EINVAL;
+            }
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    if (reserved_mask & BIT(pin)) {
+        return -EBUSY;
+    }
+
+    return 0;
+}
+
+int gpio_header_configure(uint8_t pin, uint8_t mode)
+{
+    gpio_flags_t flags;
+    int err;
+
+    err = gpio_header_check_mode(pin, mode);
+    if (err) {
+        return err;
+    }
+
+    switch (mode & GPIO_HEADER_MODE_DIRECTION_MASK) {
+        case GPIO_HEADER_MODE_DISABLED:
+            flags = GPIO_DISCONNECTED;
+            break;
+        case GPIO_HEADER_MODE_INPUT:
+            flags = GPIO_INPUT;
+            flags |= (mode & GPIO_HEADER_MODE_PULL_UP) ? GPIO_PULL_UP : 0;
+            flags |= (mode & GPIO_HEADER_MODE_PULL_DOWN) ? GPIO_PULL_DOWN : 0;
+            break;
+        case GPIO_HEADER_MODE_OUTPUT:
+            flags = GPIO_OUTPUT_INACTIVE;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    k_mutex_lock(&gpio_header_mut, K_FOREVER);
+
+    err = gpio_pin_interrupt_configure_dt(&pins[pin], GPIO_INT_DISABLE);
+    if (err) {
+        LOG_ERR("D%u interrupt disable failed (err %d)", pin, err);
+        goto unlock;
+    }
+
+    err = gpio_pin_configure_dt(&pins[pin], flags);
+    if (err) {
+        LOG_ERR("D%u configure failed (err %d)", pin, err);
+        goto unlock;
+    }
+
+    inputs_mask &= ~BIT(pin);
+    outputs_mask &= ~BIT(pin);
+    output_levels &= ~BIT(pin);
+
+    if ((mode & GPIO_HEADER_MODE_DIRECTION_MASK) == GPIO_HEADER_MODE_INPUT) {
+        err = gpio_pin_interrupt_configure_dt(&pins[pin], GPIO_INT_EDGE_BOTH);
+        if (err) {
+            LOG_ERR("D%u interrupt configure failed (err %d)", pin, err);
+            goto unlock;
+        }
+        inputs_mask |= BIT(pin);
+    } else if ((mode & GPIO_HEADER_MODE_DIRECTION_MASK) == GPIO_HEADER_MODE_OUTPUT) {
+        outputs_mask |= BIT(pin);
+    }
+
+    pin_modes[pin] = mode;
+    LOG_INF("D%u mode 0x%02x", pin, mode);
+
+unlock:
+    k_mutex_unlock(&gpio_header_mut);
+    return err;
+}
+
+uint8_t gpio_header_get_mode(uint8_t pin)
+{
+    return pin < PINS_COUNT ? pin_modes[pin] : GPIO_HEADER_MODE_DISABLED;
+}
+
+int gpio_header_set_debounce(uint16_t ms)
+{
+    if (ms > GPIO_HEADER_DEBOUNCE_MS_MAX) {
+        return -EINVAL;
+    }
+
+    debounce_ms = ms;
+    return 0;
+}
+
+uint16_t gpio_header_get_debounce(void)
+{
+    return debounce_ms;
+}
+
+uint16_t gpio_header_get_levels(void)
+{
+    uint16_t levels = output_levels;
+
+    for (size_t pin = 0; pin < PINS_COUNT; pin++) {
+        if ((inputs_mask & BIT(pin)) && gpio_pin_get_dt(&pins[pin]) > 0) {
+            levels |= BIT(pin);
+        }
+    }
+
+    return levels;
+}
+
+int gpio_header_set_outputs(uint16_t mask, uint16_t levels)
+{
+    int err = 0;
+
+    k_mutex_lock(&gpio_header_mut, K_FOREVER);
+
+    uint16_t pending = mask & outputs_mask;
+    while (pending) {
+        // Pins sharing the port of the first pending pin are written with a single masked write
+        const struct device *port = pins[find_lsb_set(pending) - 1].port;
+        gpio_port_pins_t port_mask = 0;
+        gpio_port_value_t port_value = 0;
+
+        for (size_t pin = 0; pin < PINS_COUNT; pin++) {
+            if ((pending & BIT(pin)) && pins[pin].port == port) {
+                port_mask |= BIT(pins[pin].pin);
+                port_value |= (levels & BIT(pin)) ? BIT(pins[pin].pin) : 0;
+                pending &= ~BIT(pin);
+            }
+        }
+
+        err = gpio_port_set_masked(port, port_mask, port_value);
+        if (err) {
+            LOG_ERR("Header outputs write failed (err %d)", err);
+            goto unlock;
+        }
+    }
+
+    output_levels = (output_levels & ~(mask & outputs_mask)) | (levels & mask & outputs_mask);
+
+unlock:
+    k_mutex_unlock(&gpio_header_mut);
+    return err;
+}
+
+void gpio_header_register_event_callback(gpio_header_event_callback_t callback)
+{
+    event_callback = callback;
+}
+
+int gpio_header_init(void)
+{
+    int err;
+
+    k_work_init_delayable(&debounce_work, debounce_handler);
+
+    for (size_t pin = 0; pin < PINS_COUNT; pin++) {
+        if (reserved_pin_numbers & PIN_BIT64(pin_numbers[pin])) {
+            reserved_mask |= BIT(pin);
+        }
+    }
+    if (reserved_mask) {
+        LOG_INF("Header pins reserved by the peripherals 0x%04x", reserved_mask);
+    }
+
+    for (size_t pin = 0; pin < PINS_COUNT; pin++) {
+        if (!gpio_is_ready_dt(&pins[pin])) {
+            LOG_ERR("D%zu GPIO is not ready", pin);
+            return -EIO;
+        }
+
+        gpio_init_callback(&pin_callbacks[pin], pin_interrupt_handler, BIT(pins[pin].pin));
+        err = gpio_add_callback_dt(&pins[pin], &pin_callbacks[pin]);
+        if (err) {
+            LOG_ERR("D%zu callback registration failed (err %d)", pin, err);
+            return err;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef __GPIO_HEADER_H__
+#define __GPIO_HEADER_H__
+
+#include <stdint.h>
+
+// Pin mode: bits 0-1 hold the direction, the rest are the input flags
+#define GPIO_HEADER_MODE_DISABLED 0x00
+#define GPIO_HEADER_MODE_INPUT 0x01
+#define GPIO_HEADER_MODE_OUTPUT 0x02
+#define GPIO_HEADER_MODE_DIRECTION_MASK 0x03
+#define GPIO_HEADER_MODE_PULL_UP 0x04
+#define GPIO_HEADER_MODE_PULL_DOWN 0x08
+#define GPIO_HEADER_MODE_VALID_MASK 0x0F
+
+#define GPIO_HEADER_DEBOUNCE_MS_DEFAULT 20
+#define GPIO_HEADER_DEBOUNCE_MS_MAX 1000
+
+struct gpio_header_event {
+    // Uptime of the first edge in the batch, in milliseconds
+    uint32_t timestamp_ms;
+    // Bitmask of the pins which had at least one edge in the batch
+    uint16_t changed;
+    // Bitmask of the pins levels after the debounce period
+    uint16_t levels;
+    // Total number of edges in the batch
+    uint16_t edges;
+};
+
+typedef void (*gpio_header_event_callback_t)(const struct gpio_header_event *event);
+
+/**
+ * @brief Get the number of the header pins.
+ */
+uint8_t gpio_header_pins_count(void);
+
+/**
+ * @brief Get the pins owned by an enabled peripheral or by the analog header as a bitmask (d0 = bit 0).
+ *
+ * The reserved pins stay disabled, they can not be configured.
+ */
+uint16_t gpio_header_get_reserved(void);
+
+/**
+ * @brief Check whether the header pin can be configured with the mode, without applying it.
+ *
+ * @retval 0 if the mode is valid. -EINVAL for an unknown pin or mode, -EBUSY for a reserved pin.
+ */
+int gpio_header_check_mode(uint8_t pin, uint8_t mode);
+
+/**
+ * @brief Configure the header pin.
+ *
+ * @param[in] pin Header pin index (d0 = 0).
+ * @param[in] mode Combination of the GPIO_HEADER_MODE_* flags.
+ *
+ * @retval 0 if successful. -EBUSY for a reserved pin. Negative errno number on error.
+ */
+int gpio_header_configure(uint8_t pin, uint8_t mode);
+
+/**
+ * @brief Get the header pin mode.
+ */
+uint8_t gpio_header_get_mode(uint8_t pin);
+
+/**
+ * @brief Set the debounce period applied to each batch of the input edges, counted from its first edge.
+ *
+ * @retval 0 if successful. -EINVAL above GPIO_HEADER_DEBOUNCE_MS_MAX.
+ */
+int gpio_header_set_debounce(uint16_t debounce_ms);
+
+/**
+ * @brief Get the debounce period in milliseconds.
+ */
+uint16_t gpio_header_get_debounce(void);
+
+/**
+ * @brief Get the levels of the input and output pins as a bitmask (d0 = bit 0).
+ */
+uint16_t gpio_header_get_levels(void);
+
+/**
+ * @brief Set the output pins levels. Pins not configured as outputs are ignored.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int gpio_header_set_outputs(uint16_t mask, uint16_t levels);
+
+/**
+ * @brief Register a callback function that is executed for every debounced batch of the input edges.
+ */
+void gpio_header_register_event_callback(gpio_header_event_callback_t callback);
+
+/**
+ * @brief Initialize the header pins. All of them start disabled.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int gpio_header_init(void);
+
+#endif  //__GPIO_HEADER_H__
@@ -0,0 +1,59 @@
+#include "log_control_service.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+
+LOG_MODULE_REGISTER(log_control_service, LOG_LEVEL_DBG);
+
+#define MODULE_NAME_SIZE_MAX 32
+
+/*
+ * Log level characteristic layout: the level (0 = none ... 4 = debug) followed by the module name,
+ * as registered with LOG_MODULE_REGISTER. The level is applied to all the log backends.
+ */
+static ssize_t write_log_level(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    char name[MODULE_NAME_SIZE_MAX + 1];
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    } else if (len < 2 || len > 1 + MODULE_NAME_SIZE_MAX) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    } else if (data[0] > LOG_LEVEL_DBG) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    memcpy(name, &data[1], len - 1);
+    name[len - 1] = '\0';
+
+    int source_id = log_source_id_get(name);
+    if (source_id < 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    uint32_t level = log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, data[0]);
+    LOG_INF("Log level of %s set to %u", name, level);
+
+    return len;
+}
+
+void log_control_init(void)
+{
+    uint32_t sources_count = log_src_cnt_get(Z_LOG_LOCAL_DOMAIN_ID);
+
+    for (uint32_t source_id = 0; source_id < sources_count; source_id++) {
+        // The compiled level is the ceiling a write to the level characteristic can raise the module to
+        if (log_filter_get(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, false) > LOG_CONTROL_DEFAULT_LEVEL) {
+            log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, LOG_CONTROL_DEFAULT_LEVEL);
+        }
+    }
+}
+
+BT_GATT_SERVICE_DEFINE(log_control_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_LOG_CONTROL_SERVICE),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_LOG_CONTROL_LEVEL, BT_GATT_CHRC_WRITE, BT_GATT_PERM_WRITE_ENCRYPT,
+                                              NULL, write_log_level, NULL), );
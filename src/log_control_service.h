@@ -0,0 +1,24 @@
+#ifndef __LOG_CONTROL_SERVICE_H__
+#define __LOG_CONTROL_SERVICE_H__
+
+#include <zephyr/bluetooth/uuid.h>
+
+// Log Control Service UUID Value
+#define BT_UUID_LOG_CONTROL_SERVICE_VAL BT_UUID_128_ENCODE(0x8e7f0100, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Log Control Service
+#define BT_UUID_LOG_CONTROL_SERVICE BT_UUID_DECLARE_128(BT_UUID_LOG_CONTROL_SERVICE_VAL)
+
+// Log Level Characteristic UUID Value
+#define BT_UUID_LOG_CONTROL_LEVEL_VAL BT_UUID_128_ENCODE(0x8e7f0101, 0x4b1d, 0x4c5e, 0x9a3b, 0x5f1c2d3e4f50)
+// Log Level Characteristic
+#define BT_UUID_LOG_CONTROL_LEVEL BT_UUID_DECLARE_128(BT_UUID_LOG_CONTROL_LEVEL_VAL)
+
+// Runtime level the modules start at, they are built with the debug messages so they can be raised up to it
+#define LOG_CONTROL_DEFAULT_LEVEL LOG_LEVEL_INF
+
+/**
+ * @brief Lower every log module built above LOG_CONTROL_DEFAULT_LEVEL to it at runtime.
+ */
+void log_control_init(void);
+
+#endif  //__LOG_CONTROL_SERVICE_H__
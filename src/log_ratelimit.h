@@ -0,0 +1,29 @@
+#ifndef __LOG_RATELIMIT_H__
+#define __LOG_RATELIMIT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+// Minimum interval between two periodic sample logs of a module
+#define SAMPLE_LOG_INTERVAL_MS (5 * 60 * 1000)
+
+/**
+ * @brief Check if a rate limited log is allowed and restart the interval if so.
+ *
+ * @param[in,out] logged_at_ms Uptime of the last allowed log, 0 if none yet.
+ * @param[in] interval_ms Minimum interval between two allowed logs.
+ */
+static inline bool log_ratelimit_allow(int64_t *logged_at_ms, uint32_t interval_ms)
+{
+    int64_t now_ms = k_uptime_get();
+
+    if (*logged_at_ms != 0 && now_ms - *logged_at_ms < interval_ms) {
+        return false;
+    }
+
+    *logged_at_ms = now_ms;
+    return true;
+}
+
+#endif  //__LOG_RATELIMIT_H__
@@ -1,153 +1,268 @@
 #include <zephyr/bluetooth/conn.h>
-#include <zephyr/bluetooth/gap.h>
 #include <zephyr/bluetooth/hci.h>
-#include <zephyr/bluetooth/uuid.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
 
+#include "advertising.h"
 #include "automation_io_service.h"
 #include "battery_service.h"
 #include "environmental_service.h"
+#include "log_control_service.h"
+#include "motion.h"
+#include "motion_policy.h"
 
-LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 
-#define SLOW_DOWN_AD_RATE_AFTER_SEC 30
+#define BT_READY_TIMEOUT_MS 5000
+#define BOOT_PHASES_MAX 9
+// New centrals may only pair this long after boot (or while there is no bond), power cycling opens it again
+#define PAIRING_WINDOW_SEC 120
 
-#define BT_LE_ADV_CONN_FAST \
-    BT_LE_ADV_PARAM(BT_LE_ADV_OPT_CONN, BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, NULL)
-
-#define BT_LE_ADV_CONN_SLOW BT_LE_ADV_PARAM(BT_LE_ADV_OPT_CONN, BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, NULL)
-
-static const struct bt_data ad[] = {
-    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-    BT_DATA_BYTES(BT_DATA_UUID16_ALL, BT_UUID_16_ENCODE(BT_UUID_BAS_VAL), BT_UUID_16_ENCODE(BT_UUID_ESS_VAL),
-                  BT_UUID_16_ENCODE(BT_UUID_AIOS_VAL)),
+struct boot_phase {
+    const char *name;
+    uint32_t done_us;
 };
 
-static const struct bt_data sd[] = {
-    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
-};
+static struct boot_phase boot_phases[BOOT_PHASES_MAX];
+static size_t boot_phases_count = 0;
 
-static struct k_work_delayable slow_down_ad_rate_work;
+static K_SEM_DEFINE(bt_ready_sem, 0, 1);
+static int bt_ready_err;
+static uint32_t bt_ready_us;
 
-static bool restart_advertisement = false;
+// Uptime of the last connection, to measure the time to encryption on reconnects
+static int64_t connected_at_ms;
 
-static void bt_ready(int err)
+static uint32_t uptime_us(void)
 {
-    if (err) {
-        LOG_ERR("Bluetooth initialization failed (err %d)", err);
-        return;
+    return k_ticks_to_us_floor32(k_uptime_ticks());
+}
+
+static void boot_phase_done(const char *name)
+{
+    if (boot_phases_count < ARRAY_SIZE(boot_phases)) {
+        boot_phases[boot_phases_count++] = (struct boot_phase){name, uptime_us()};
     }
+}
 
-    LOG_INF("Bluetooth initialized");
+static void boot_report(void)
+{
+    uint32_t started_us = 0;
 
-    err = bt_le_adv_start(BT_LE_ADV_CONN_FAST, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-    if (err) {
-        LOG_ERR("Advertising failed to start (err %d)", err);
-        return;
+    for (size_t i = 0; i < boot_phases_count; i++) {
+        LOG_INF("Boot phase %-12s %7u us (done at %7u us)", boot_phases[i].name,
+                boot_phases[i].done_us - started_us, boot_phases[i].done_us);
+        started_us = boot_phases[i].done_us;
     }
 
-    k_work_schedule(&slow_down_ad_rate_work, K_SECONDS(SLOW_DOWN_AD_RATE_AFTER_SEC));
+    LOG_INF("Bluetooth controller ready at %u us", bt_ready_us);
+}
 
-    LOG_INF("Advertising successfully started");
+static void bt_ready(int err)
+{
+    bt_ready_us = uptime_us();
+    bt_ready_err = err;
+
+    if (!err) {
+        // Restore the bonds and their CCC state before any central is able to connect
+        if (IS_ENABLED(CONFIG_SETTINGS)) {
+            err = settings_load();
+            if (err) {
+                LOG_ERR("Settings load failed (err %d)", err);
+            }
+        }
+    }
+
+    k_sem_give(&bt_ready_sem);
 }
 
 static void bt_connected(struct bt_conn *conn, uint8_t err)
 {
     char addr[BT_ADDR_LE_STR_LEN];
 
-    k_work_cancel_delayable(&slow_down_ad_rate_work);
+    // The directed advertising ended without a connection, the advertising module moves on to its next stage
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        return;
+    }
 
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
     if (err) {
         LOG_ERR("Connection failed, err 0x%02x %s", err, bt_hci_err_to_str(err));
     } else {
+        connected_at_ms = k_uptime_get();
         LOG_INF("Connected to %s", addr);
+
+        // Re-encrypts a bonded central, pairs (Just Works) with a new one, so the CCC state persists
+        int ret = bt_conn_set_security(conn, BT_SECURITY_L2);
+        if (ret) {
+            LOG_WRN("Failed to request security with %s (err %d)", addr, ret);
+        }
     }
 }
 
-static void bt_disconnected(struct bt_conn *conn, uint8_t reason)
+static void bt_security_changed(struct bt_conn *conn, bt_security_t level, enum bt_security_err err)
 {
     char addr[BT_ADDR_LE_STR_LEN];
 
-    restart_advertisement = true;
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    if (err) {
+        LOG_ERR("Security failed with %s (level %u, err %d)", addr, level, err);
+        return;
+    }
+
+    LOG_INF("Security level %u with %s after %lld ms", level, addr, k_uptime_get() - connected_at_ms);
+}
+
+static void bt_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
 
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
     LOG_INF("Disconnected from %s (reason 0x%02x)", addr, reason);
 }
 
-static void bt_recycled()
+static void count_bond(const struct bt_bond_info *info, void *user_data)
 {
-    if (!restart_advertisement) {
-        return;
-    }
-    restart_advertisement = false;
+    size_t *count = user_data;
 
-    int err = bt_le_adv_start(BT_LE_ADV_CONN_FAST, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-    if (err) {
-        LOG_ERR("Advertising failed to restart (err %d)", err);
-        return;
+    (*count)++;
+}
+
+static enum bt_security_err bt_pairing_accept(struct bt_conn *conn, const struct bt_conn_pairing_feat *const feat)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
+    size_t bonds = 0;
+
+    // A bonded central may refresh its keys at any time
+    if (bt_addr_le_is_bonded(BT_ID_DEFAULT, bt_conn_get_dst(conn))) {
+        return BT_SECURITY_ERR_SUCCESS;
     }
 
-    k_work_schedule(&slow_down_ad_rate_work, K_SECONDS(SLOW_DOWN_AD_RATE_AFTER_SEC));
+    bt_foreach_bond(BT_ID_DEFAULT, count_bond, &bonds);
+    if (bonds == 0 || k_uptime_get() < PAIRING_WINDOW_SEC * MSEC_PER_SEC) {
+        return BT_SECURITY_ERR_SUCCESS;
+    }
 
-    LOG_INF("Advertising successfully restarted");
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    LOG_WRN("Pairing with %s rejected outside of the pairing window", addr);
+    return BT_SECURITY_ERR_PAIR_NOT_ALLOWED;
 }
 
-static void slow_down_ad_rate(struct k_work *work)
+static void bt_pairing_complete(struct bt_conn *conn, bool bonded)
 {
-    int err;
+    char addr[BT_ADDR_LE_STR_LEN];
 
-    err = bt_le_adv_stop();
-    if (err) {
-        LOG_ERR("Advertising failed to stop (err %d)", err);
-        return;
-    }
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    LOG_INF("Pairing with %s completed (%s)", addr, bonded ? "bonded" : "not bonded");
+}
 
-    err = bt_le_adv_start(BT_LE_ADV_CONN_SLOW, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-    if (err) {
-        LOG_ERR("Advertising failed start (err %d)", err);
-        return;
-    }
+static void bt_pairing_failed(struct bt_conn *conn, enum bt_security_err reason)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
 
-    LOG_INF("Advertising rate changed");
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    LOG_ERR("Pairing with %s failed (reason %d)", addr, reason);
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = bt_connected,
     .disconnected = bt_disconnected,
-    .recycled = bt_recycled,
+    .security_changed = bt_security_changed,
+};
+
+static void motion_changed(bool is_moving)
+{
+    environmental_service_set_sampling_interval(motion_policy_sampling_interval_ms(is_moving));
+    advertising_set_fast_interval(is_moving);
+}
+
+static struct bt_conn_auth_cb auth_callbacks = {
+    .pairing_accept = bt_pairing_accept,
+};
+
+static struct bt_conn_auth_info_cb auth_info_callbacks = {
+    .pairing_complete = bt_pairing_complete,
+    .pairing_failed = bt_pairing_failed,
 };
 
 int main(void)
 {
     int err;
 
-    k_work_init_delayable(&slow_down_ad_rate_work, slow_down_ad_rate);
+    boot_phase_done("kernel");
+
+    log_control_init();
+
+    err = bt_conn_auth_cb_register(&auth_callbacks);
+    if (err) {
+        LOG_ERR("Failed to register authorization callbacks (err %d)", err);
+        return 0;
+    }
+
+    err = bt_conn_auth_info_cb_register(&auth_info_callbacks);
+    if (err) {
+        LOG_ERR("Failed to register authorization info callbacks (err %d)", err);
+        return 0;
+    }
 
+    // The controller comes up in the background while the first samples are taken
     err = bt_enable(bt_ready);
     if (err) {
         LOG_ERR("Bluetooth initialization failed (err %d)", err);
         return 0;
     }
+    boot_phase_done("bt_enable");
 
     err = environmental_service_start();
     if (err) {
         LOG_ERR("Failed to start Environmental Sensing Service (error %d)", err);
         return 0;
     }
+    boot_phase_done("environment");
 
     err = battery_service_start();
     if (err) {
         LOG_ERR("Failed to start Battery Service (error %d)", err);
         return 0;
     }
+    boot_phase_done("battery");
 
     err = automation_io_service_start();
     if (err) {
         LOG_ERR("Failed to start LED Service (err %d)", err);
         return 0;
     }
+    boot_phase_done("aios");
+
+    // Without the IMU the services keep sampling and advertising at their default rates
+    motion_register_callback(motion_changed);
+    err = motion_start();
+    if (err) {
+        LOG_WRN("Motion detection is not available (err %d)", err);
+    }
+    boot_phase_done("motion");
+
+    err = k_sem_take(&bt_ready_sem, K_MSEC(BT_READY_TIMEOUT_MS));
+    if (err || bt_ready_err) {
+        LOG_ERR("Bluetooth initialization failed (err %d)", err ? err : bt_ready_err);
+        return 0;
+    }
+    boot_phase_done("bt_ready");
+
+    LOG_INF("Bluetooth initialized");
+
+    // Advertising starts with the service data of the samples taken above
+    err = advertising_start();
+    if (err) {
+        LOG_ERR("Advertising failed to start (err %d)", err);
+        return 0;
+    }
+    boot_phase_done("advertising");
+
+    LOG_INF("Advertising successfully started");
+
+    boot_report();
 
     return 0;
 }
@@ -0,0 +1,202 @@
+#include "motion.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "motion_policy.h"
+#include "trace_points.h"
+
+LOG_MODULE_REGISTER(motion, LOG_LEVEL_DBG);
+
+#if !DT_NODE_EXISTS(DT_NODELABEL(lsm6ds3tr_c))
+#error "Board has no lsm6ds3tr_c IMU node."
+#endif
+
+#define IMU_NODE DT_NODELABEL(lsm6ds3tr_c)
+
+// LSM6DS3TR-C registers, the embedded wake-up function is not exposed by the sensor driver
+#define LSM6DS3TR_C_WHO_AM_I 0x0F
+#define LSM6DS3TR_C_WHO_AM_I_VALUE 0x6A
+#define LSM6DS3TR_C_CTRL1_XL 0x10
+#define LSM6DS3TR_C_CTRL2_G 0x11
+#define LSM6DS3TR_C_CTRL3_C 0x12
+#define LSM6DS3TR_C_CTRL6_C 0x15
+#define LSM6DS3TR_C_WAKE_UP_SRC 0x1B
+#define LSM6DS3TR_C_TAP_CFG 0x58
+#define LSM6DS3TR_C_WAKE_UP_THS 0x5B
+#define LSM6DS3TR_C_WAKE_UP_DUR 0x5C
+#define LSM6DS3TR_C_MD1_CFG 0x5E
+
+#define CTRL1_XL_ODR_12_5HZ 0x10
+#define CTRL3_C_SW_RESET BIT(0)
+#define CTRL3_C_IF_INC BIT(2)
+#define CTRL6_C_XL_HM_MODE BIT(4)
+#define TAP_CFG_LIR BIT(0)
+#define TAP_CFG_INTERRUPTS_ENABLE BIT(7)
+#define MD1_CFG_INT1_WU BIT(5)
+#define WAKE_UP_SRC_WU_IA BIT(3)
+
+// Wake-up threshold, 1 LSB is 2 g / 64 = 31.25 mg at the default full scale
+#define WAKE_UP_THRESHOLD 2
+#define RESET_TIME_US 100
+
+struct register_value {
+    uint8_t reg;
+    uint8_t value;
+};
+
+/*
+ * Accelerometer only, at 12.5 Hz in the low power mode, the slope of any axis above the threshold
+ * latches the wake-up interrupt on INT1 until WAKE_UP_SRC is read.
+ */
+static const struct register_value wake_up_config[] = {
+    {LSM6DS3TR_C_CTRL3_C, CTRL3_C_IF_INC},
+    {LSM6DS3TR_C_CTRL2_G, 0x00},
+    {LSM6DS3TR_C_CTRL6_C, CTRL6_C_XL_HM_MODE},
+    {LSM6DS3TR_C_CTRL1_XL, CTRL1_XL_ODR_12_5HZ},
+    {LSM6DS3TR_C_WAKE_UP_DUR, 0x00},
+    {LSM6DS3TR_C_WAKE_UP_THS, WAKE_UP_THRESHOLD},
+    {LSM6DS3TR_C_TAP_CFG, TAP_CFG_INTERRUPTS_ENABLE | TAP_CFG_LIR},
+    {LSM6DS3TR_C_MD1_CFG, MD1_CFG_INT1_WU},
+};
+
+static const struct i2c_dt_spec imu = I2C_DT_SPEC_GET(IMU_NODE);
+static const struct gpio_dt_spec imu_irq = GPIO_DT_SPEC_GET(IMU_NODE, irq_gpios);
+
+static struct gpio_callback irq_callback;
+static motion_callback_t motion_callback = NULL;
+static atomic_t is_moving = ATOMIC_INIT(0);
+// Only used from the system workqueue, and by motion_start before the interrupt is enabled
+static struct motion_policy policy;
+
+static void wake_up_handler(struct k_work *work);
+static void stillness_handler(struct k_work *work);
+
+static K_WORK_DEFINE(wake_up_work, wake_up_handler);
+static K_WORK_DELAYABLE_DEFINE(stillness_work, stillness_handler);
+
+static void irq_handler(const struct device *port, struct gpio_callback *cb, gpio_port_pins_t pins)
+{
+    k_work_submit(&wake_up_work);
+}
+
+static void set_moving(bool moving)
+{
+    if (atomic_set(&is_moving, moving) == moving) {
+        return;
+    }
+
+    TRACE_POINT("motion", moving, 0);
+    LOG_INF("Device is %s", moving ? "moving" : "stationary");
+
+    if (motion_callback) {
+        motion_callback(moving);
+    }
+}
+
+static void wake_up_handler(struct k_work *work)
+{
+    uint8_t source;
+
+    // Reading the source releases the latched interrupt, so the next wake-up raises a new edge
+    int err = i2c_reg_read_byte_dt(&imu, LSM6DS3TR_C_WAKE_UP_SRC, &source);
+    if (err) {
+        LOG_WRN("Wake-up source read failed (err %d)", err);
+        return;
+    }
+    if (motion_policy_wake_up(&policy, source & WAKE_UP_SRC_WU_IA)) {
+        k_work_reschedule(&stillness_work, K_SECONDS(MOTION_STILLNESS_TIMEOUT_SEC));
+    }
+    set_moving(policy.is_moving);
+}
+
+static void stillness_handler(struct k_work *work)
+{
+    uint8_t source;
+    bool wake_up_latched = false;
+
+    // An interrupt still latched is a wake-up the wake-up work could not read, reading the source releases it
+    if (gpio_pin_get_dt(&imu_irq) > 0) {
+        int err = i2c_reg_read_byte_dt(&imu, LSM6DS3TR_C_WAKE_UP_SRC, &source);
+        wake_up_latched = !err && (source & WAKE_UP_SRC_WU_IA);
+    }
+
+    if (motion_policy_stillness_timeout(&policy, wake_up_latched)) {
+        k_work_reschedule(&stillness_work, K_SECONDS(MOTION_STILLNESS_TIMEOUT_SEC));
+    }
+    set_moving(policy.is_moving);
+}
+
+void motion_register_callback(motion_callback_t callback)
+{
+    motion_callback = callback;
+}
+
+bool motion_is_moving(void)
+{
+    return atomic_get(&is_moving);
+}
+
+int motion_start(void)
+{
+    uint8_t who_am_i;
+    int err;
+
+    if (!i2c_is_ready_dt(&imu) || !gpio_is_ready_dt(&imu_irq)) {
+        LOG_ERR("IMU bus or interrupt is not ready");
+        return -ENODEV;
+    }
+
+    err = i2c_reg_read_byte_dt(&imu, LSM6DS3TR_C_WHO_AM_I, &who_am_i);
+    if (err) {
+        LOG_ERR("IMU is not responding (err %d)", err);
+        return err;
+    }
+    if (who_am_i != LSM6DS3TR_C_WHO_AM_I_VALUE) {
+        LOG_ERR("Unexpected IMU identifier 0x%02x", who_am_i);
+        return -ENODEV;
+    }
+
+    // The IMU keeps its configuration across the warm resets, start from the defaults
+    err = i2c_reg_write_byte_dt(&imu, LSM6DS3TR_C_CTRL3_C, CTRL3_C_SW_RESET);
+    if (err) {
+        return err;
+    }
+    k_busy_wait(RESET_TIME_US);
+
+    for (size_t i = 0; i < ARRAY_SIZE(wake_up_config); i++) {
+        err = i2c_reg_write_byte_dt(&imu, wake_up_config[i].reg, wake_up_config[i].value);
+        if (err) {
+            LOG_ERR("IMU register 0x%02x write failed (err %d)", wake_up_config[i].reg, err);
+            return err;
+        }
+    }
+
+    motion_policy_init(&policy);
+
+    err = gpio_pin_configure_dt(&imu_irq, GPIO_INPUT);
+    if (err) {
+        return err;
+    }
+
+    gpio_init_callback(&irq_callback, irq_handler, BIT(imu_irq.pin));
+    err = gpio_add_callback_dt(&imu_irq, &irq_callback);
+    if (err) {
+        return err;
+    }
+
+    err = gpio_pin_interrupt_configure_dt(&imu_irq, GPIO_INT_EDGE_TO_ACTIVE);
+    if (err) {
+        return err;
+    }
+
+    k_work_schedule(&stillness_work, K_SECONDS(MOTION_STILLNESS_TIMEOUT_SEC));
+    set_moving(policy.is_moving);
+
+    return 0;
+}
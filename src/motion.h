@@ -0,0 +1,30 @@
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#include <stdbool.h>
+
+// Time without any wake-up event before the device is considered stationary
+#define MOTION_STILLNESS_TIMEOUT_SEC 120
+
+typedef void (*motion_callback_t)(bool is_moving);
+
+/**
+ * @brief Register a callback function that is executed on the transitions between moving and stationary.
+ */
+void motion_register_callback(motion_callback_t callback);
+
+/**
+ * @brief Check whether a wake-up event occurred within the stillness timeout.
+ */
+bool motion_is_moving(void);
+
+/**
+ * @brief Put the onboard IMU into its low power wake-up mode and start tracking the motion.
+ *
+ * The device starts as moving, the callback is executed right away.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int motion_start(void);
+
+#endif  //__MOTION_H__
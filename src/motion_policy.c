@@ -0,0 +1,33 @@
+#include "motion_policy.h"
+
+void motion_policy_init(struct motion_policy *policy)
+{
+    policy->is_moving = true;
+}
+
+bool motion_policy_wake_up(struct motion_policy *policy, bool woke_up)
+{
+    if (!woke_up) {
+        return false;
+    }
+
+    policy->is_moving = true;
+    return true;
+}
+
+bool motion_policy_stillness_timeout(struct motion_policy *policy, bool wake_up_latched)
+{
+    // A latched wake-up is a motion within the timeout, the device did not keep still
+    if (wake_up_latched) {
+        policy->is_moving = true;
+        return true;
+    }
+
+    policy->is_moving = false;
+    return false;
+}
+
+uint32_t motion_policy_sampling_interval_ms(bool is_moving)
+{
+    return is_moving ? MOTION_POLICY_MOVING_SAMPLING_INTERVAL_MS : MOTION_POLICY_STATIONARY_SAMPLING_INTERVAL_MS;
+}
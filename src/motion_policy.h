@@ -0,0 +1,47 @@
+#ifndef __MOTION_POLICY_H__
+#define __MOTION_POLICY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Environmental sampling intervals of a moving and of a stationary device
+#define MOTION_POLICY_MOVING_SAMPLING_INTERVAL_MS 5000
+#define MOTION_POLICY_STATIONARY_SAMPLING_INTERVAL_MS 60000
+
+/*
+ * Moving / stationary decision from the IMU wake-up events, kept free of the I2C and the work items
+ * so it can be tested on its own. The caller (re)starts the stillness timeout whenever asked to.
+ */
+struct motion_policy {
+    bool is_moving;
+};
+
+/**
+ * @brief Start as moving, the stillness timeout has to be started.
+ */
+void motion_policy_init(struct motion_policy *policy);
+
+/**
+ * @brief Handle a wake-up interrupt.
+ *
+ * @param[in] woke_up Whether the wake-up source reported a wake-up (WU_IA).
+ *
+ * @return true if the stillness timeout has to be restarted.
+ */
+bool motion_policy_wake_up(struct motion_policy *policy, bool woke_up);
+
+/**
+ * @brief Handle the expired stillness timeout.
+ *
+ * @param[in] wake_up_latched Whether a wake-up was still latched in the IMU, one the wake-up interrupt missed.
+ *
+ * @return true if the stillness timeout has to be restarted, the device is still moving.
+ */
+bool motion_policy_stillness_timeout(struct motion_policy *policy, bool wake_up_latched);
+
+/**
+ * @brief Environmental sampling interval for the motion state, the advertising keeps its fast interval while moving.
+ */
+uint32_t motion_policy_sampling_interval_ms(bool is_moving);
+
+#endif  //__MOTION_POLICY_H__
@@ -0,0 +1,234 @@
+#include "notification_dispatcher.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "trace_points.h"
+
+LOG_MODULE_REGISTER(notification_dispatcher, LOG_LEVEL_DBG);
+
+#define NOTIFICATION_ATTRS_MAX 16
+// Delay before the next attempt when the stack runs out of the ATT buffers
+#define RETRY_DELAY_MS 20
+
+struct notification_slot {
+    uint8_t value[NOTIFICATION_VALUE_SIZE_MAX];
+    uint16_t len;
+    bool is_pending;
+    bool is_in_flight;
+    struct bt_gatt_notify_params params;
+};
+
+struct submit_context {
+    size_t index;
+    const void *data;
+    uint16_t len;
+};
+
+static const struct bt_gatt_attr *attrs[NOTIFICATION_ATTRS_MAX];
+static size_t attrs_count = 0;
+
+// One slot per characteristic and per connection
+static struct notification_slot slots[CONFIG_BT_MAX_CONN][NOTIFICATION_ATTRS_MAX];
+static struct notification_stats stats;
+static struct k_spinlock lock;
+
+static void dispatch_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(dispatch_work, dispatch_handler);
+
+static int attr_index(const struct bt_gatt_attr *attr)
+{
+    for (size_t i = 0; i < attrs_count; i++) {
+        if (attrs[i] == attr) {
+            return i;
+        }
+    }
+
+    if (attrs_count == NOTIFICATION_ATTRS_MAX) {
+        return -ENOMEM;
+    }
+
+    attrs[attrs_count] = attr;
+    return attrs_count++;
+}
+
+static void submit_to_conn(struct bt_conn *conn, void *user_data)
+{
+    struct submit_context *context = user_data;
+    struct notification_slot *slot = &slots[bt_conn_index(conn)][context->index];
+
+    if (!bt_gatt_is_subscribed(conn, attrs[context->index], BT_GATT_CCC_NOTIFY)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    // The latest value wins, the stale one is never sent
+    if (slot->is_pending) {
+        stats.coalesced++;
+    }
+    memcpy(slot->value, context->data, context->len);
+    slot->len = context->len;
+    slot->is_pending = true;
+
+    k_spin_unlock(&lock, key);
+}
+
+static void notification_sent(struct bt_conn *conn, void *user_data)
+{
+    struct notification_slot *slot = user_data;
+    bool is_pending;
+
+    TRACE_POINT("notify_sent", bt_conn_index(conn), 0);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    // The slot could have been reset by a disconnection in the meantime
+    if (slot->is_in_flight) {
+        slot->is_in_flight = false;
+        stats.in_flight--;
+        stats.sent++;
+    }
+    is_pending = slot->is_pending;
+
+    k_spin_unlock(&lock, key);
+
+    if (is_pending) {
+        k_work_reschedule(&dispatch_work, K_NO_WAIT);
+    }
+}
+
+static void dispatch_to_conn(struct bt_conn *conn, void *user_data)
+{
+    bool *retry = user_data;
+    struct notification_slot *conn_slots = slots[bt_conn_index(conn)];
+
+    for (size_t i = 0; i < attrs_count; i++) {
+        struct notification_slot *slot = &conn_slots[i];
+        uint8_t value[NOTIFICATION_VALUE_SIZE_MAX];
+        uint16_t len;
+        int err;
+
+        k_spinlock_key_t key = k_spin_lock(&lock);
+
+        if (!slot->is_pending || slot->is_in_flight) {
+            k_spin_unlock(&lock, key);
+            continue;
+        }
+
+        memcpy(value, slot->value, slot->len);
+        len = slot->len;
+        slot->is_pending = false;
+        slot->is_in_flight = true;
+        stats.in_flight++;
+        stats.in_flight_max = MAX(stats.in_flight_max, stats.in_flight);
+
+        k_spin_unlock(&lock, key);
+
+        slot->params = (struct bt_gatt_notify_params){
+            .attr = attrs[i],
+            .data = value,
+            .len = len,
+            .func = notification_sent,
+            .user_data = slot,
+        };
+
+        err = bt_gatt_notify_cb(conn, &slot->params);
+        TRACE_POINT("notify_tx", i, err);
+        if (!err) {
+            continue;
+        }
+
+        key = k_spin_lock(&lock);
+
+        slot->is_in_flight = false;
+        stats.in_flight--;
+
+        if (err == -ENOMEM || err == -ENOBUFS) {
+            // Out of buffers, try again later unless a newer value has already replaced this one
+            if (!slot->is_pending) {
+                memcpy(slot->value, value, len);
+                slot->len = len;
+                slot->is_pending = true;
+            }
+            *retry = true;
+        } else {
+            stats.dropped++;
+        }
+
+        k_spin_unlock(&lock, key);
+
+        if (err != -ENOMEM && err != -ENOBUFS) {
+            LOG_DBG("Notification dropped (err %d)", err);
+        }
+    }
+}
+
+static void dispatch_handler(struct k_work *work)
+{
+    bool retry = false;
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, dispatch_to_conn, &retry);
+
+    if (retry) {
+        k_work_schedule(&dispatch_work, K_MSEC(RETRY_DELAY_MS));
+    }
+}
+
+int notification_dispatcher_submit(const struct bt_gatt_attr *attr, const void *data, uint16_t len)
+{
+    struct submit_context context = {.data = data, .len = len};
+
+    if (len > NOTIFICATION_VALUE_SIZE_MAX) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int index = attr_index(attr);
+    k_spin_unlock(&lock, key);
+
+    if (index < 0) {
+        LOG_ERR("Maximum number of characteristics reached, operation aborted");
+        return index;
+    }
+    context.index = index;
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, submit_to_conn, &context);
+    k_work_reschedule(&dispatch_work, K_NO_WAIT);
+
+    return 0;
+}
+
+void notification_dispatcher_get_stats(struct notification_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = stats;
+    k_spin_unlock(&lock, key);
+}
+
+static void dispatcher_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    struct notification_slot *conn_slots = slots[bt_conn_index(conn)];
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    for (size_t i = 0; i < NOTIFICATION_ATTRS_MAX; i++) {
+        if (conn_slots[i].is_pending) {
+            stats.dropped++;
+        }
+        if (conn_slots[i].is_in_flight) {
+            stats.in_flight--;
+        }
+        conn_slots[i].is_pending = false;
+        conn_slots[i].is_in_flight = false;
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+BT_CONN_CB_DEFINE(dispatcher_conn_callbacks) = {
+    .disconnected = dispatcher_disconnected,
+};
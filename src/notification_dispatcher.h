@@ -0,0 +1,40 @@
+#ifndef __NOTIFICATION_DISPATCHER_H__
+#define __NOTIFICATION_DISPATCHER_H__
+
+#include <stdint.h>
+#include <zephyr/bluetooth/gatt.h>
+
+// Maximum size of a notified value
+#define NOTIFICATION_VALUE_SIZE_MAX 20
+
+struct notification_stats {
+    // Notifications completed by the stack
+    uint32_t sent;
+    // Pending values replaced by a newer one before they were sent
+    uint32_t coalesced;
+    // Values given up on, because of a send error, unsubscription or disconnection
+    uint32_t dropped;
+    // Notifications currently waiting for the completion
+    uint32_t in_flight;
+    // Maximum of the notifications waiting for the completion at once
+    uint32_t in_flight_max;
+};
+
+/**
+ * @brief Notify the characteristic value to all the subscribed connections.
+ *
+ * Every characteristic has a single slot per connection: a value which is still pending replaces
+ * the previous one, and only one notification per slot waits for the completion at a time.
+ *
+ * @param[in] attr Characteristic value attribute.
+ *
+ * @retval 0 if successful. Negative errno number on error.
+ */
+int notification_dispatcher_submit(const struct bt_gatt_attr *attr, const void *data, uint16_t len);
+
+/**
+ * @brief Get the notifications statistics.
+ */
+void notification_dispatcher_get_stats(struct notification_stats *stats);
+
+#endif  //__NOTIFICATION_DISPATCHER_H__
@@ -0,0 +1,206 @@
+#include "pressure_trend.h"
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+// One point per minute, the longest window sets the history length
+#define WINDOW_1H 60
+#define WINDOW_3H 180
+#define HISTORY_SIZE WINDOW_3H
+// Missing minutes interpolated at most, a longer gap restarts the estimation
+#define GAP_MAX_MINUTES 30
+// Points of the 3 hours window needed for the tendency
+#define TENDENCY_POINTS_MIN 60
+
+// Tendency thresholds, the pressure change over 3 hours in Pa
+#define TENDENCY_STEADY_MAX 10
+#define TENDENCY_SLOWLY_MAX 150
+#define TENDENCY_NORMAL_MAX 350
+#define TENDENCY_QUICKLY_MAX 600
+
+// Sea level pressure levels of the forecast in 0.1 Pa
+#define FORECAST_LOW 1009000
+#define FORECAST_HIGH 1022000
+
+/*
+ * Least squares over the points x = 0 .. n - 1 of the window: S = sum(y), T = sum(x * y).
+ * Sliding by one point: S' = S - y_old + y_new and T' = T + n * y_new - S'.
+ */
+struct trend_window {
+    uint16_t length;
+    uint16_t count;
+    int64_t sum;
+    int64_t weighted_sum;
+};
+
+static struct trend_window windows[] = {{.length = WINDOW_1H}, {.length = WINDOW_3H}};
+// Minute averages in 0.1 Pa
+static uint32_t history[HISTORY_SIZE];
+static size_t history_head = 0;
+
+static int64_t bucket_minute = -1;
+static uint64_t bucket_sum = 0;
+static uint32_t bucket_count = 0;
+
+static int64_t pushed_minute = -1;
+static uint32_t pushed_pressure = 0;
+
+static struct pressure_trend trend;
+static struct k_spinlock lock;
+
+static void window_push(struct trend_window *window, uint32_t pressure)
+{
+    if (window->count < window->length) {
+        window->weighted_sum += (int64_t)window->count * pressure;
+        window->sum += pressure;
+        window->count++;
+        return;
+    }
+
+    uint32_t oldest = history[(history_head + HISTORY_SIZE - window->length) % HISTORY_SIZE];
+    window->sum += (int64_t)pressure - oldest;
+    window->weighted_sum += (int64_t)window->length * pressure - window->sum;
+}
+
+static void history_push(uint32_t pressure)
+{
+    // The windows read their oldest point before it is overwritten
+    for (size_t i = 0; i < ARRAY_SIZE(windows); i++) {
+        window_push(&windows[i], pressure);
+    }
+
+    history[history_head] = pressure;
+    history_head = (history_head + 1) % HISTORY_SIZE;
+}
+
+static void history_reset(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(windows); i++) {
+        windows[i].count = 0;
+        windows[i].sum = 0;
+        windows[i].weighted_sum = 0;
+    }
+    history_head = 0;
+}
+
+// Slope in Pa per hour, from the points in 0.1 Pa per minute
+static int16_t window_slope(const struct trend_window *window)
+{
+    int64_t n = window->count;
+
+    if (n < 2) {
+        return 0;
+    }
+
+    int64_t sum_x = n * (n - 1) / 2;
+    int64_t denominator = n * n * (n * n - 1) / 12;
+    int64_t slope = 6 * (n * window->weighted_sum - sum_x * window->sum) / denominator;
+
+    return CLAMP(slope, INT16_MIN, INT16_MAX);
+}
+
+static enum pressure_tendency tendency_classify(const struct trend_window *window, int16_t slope)
+{
+    int32_t change = abs(slope * 3);
+    bool rising = slope > 0;
+
+    if (window->count < TENDENCY_POINTS_MIN) {
+        return PRESSURE_TENDENCY_UNKNOWN;
+    } else if (change < TENDENCY_STEADY_MAX) {
+        return PRESSURE_TENDENCY_STEADY;
+    } else if (change <= TENDENCY_SLOWLY_MAX) {
+        return rising ? PRESSURE_TENDENCY_RISING_SLOWLY : PRESSURE_TENDENCY_FALLING_SLOWLY;
+    } else if (change <= TENDENCY_NORMAL_MAX) {
+        return rising ? PRESSURE_TENDENCY_RISING : PRESSURE_TENDENCY_FALLING;
+    } else if (change <= TENDENCY_QUICKLY_MAX) {
+        return rising ? PRESSURE_TENDENCY_RISING_QUICKLY : PRESSURE_TENDENCY_FALLING_QUICKLY;
+    }
+    return rising ? PRESSURE_TENDENCY_RISING_VERY_RAPIDLY : PRESSURE_TENDENCY_FALLING_VERY_RAPIDLY;
+}
+
+static enum pressure_forecast forecast_classify(enum pressure_tendency tendency, uint32_t sea_level_pressure)
+{
+    switch (tendency) {
+    case PRESSURE_TENDENCY_FALLING_QUICKLY:
+    case PRESSURE_TENDENCY_FALLING_VERY_RAPIDLY:
+        return PRESSURE_FORECAST_STORMY;
+    case PRESSURE_TENDENCY_FALLING:
+        return sea_level_pressure < FORECAST_LOW ? PRESSURE_FORECAST_RAIN : PRESSURE_FORECAST_UNSETTLED;
+    case PRESSURE_TENDENCY_FALLING_SLOWLY:
+        return sea_level_pressure < FORECAST_LOW ? PRESSURE_FORECAST_UNSETTLED : PRESSURE_FORECAST_NO_CHANGE;
+    case PRESSURE_TENDENCY_STEADY:
+        if (sea_level_pressure > FORECAST_HIGH) {
+            return PRESSURE_FORECAST_FAIR;
+        }
+        return sea_level_pressure < FORECAST_LOW ? PRESSURE_FORECAST_RAIN : PRESSURE_FORECAST_NO_CHANGE;
+    case PRESSURE_TENDENCY_RISING_SLOWLY:
+    case PRESSURE_TENDENCY_RISING:
+        return sea_level_pressure > FORECAST_HIGH ? PRESSURE_FORECAST_FAIR : PRESSURE_FORECAST_IMPROVING;
+    case PRESSURE_TENDENCY_RISING_QUICKLY:
+    case PRESSURE_TENDENCY_RISING_VERY_RAPIDLY:
+        return PRESSURE_FORECAST_UNSETTLED;
+    default:
+        return PRESSURE_FORECAST_UNKNOWN;
+    }
+}
+
+// Push the closed minute average, with the missing minutes since the previous one interpolated
+static void bucket_close(void)
+{
+    uint32_t pressure = bucket_sum / bucket_count;
+    int64_t gap = bucket_minute - pushed_minute;
+
+    if (pushed_minute < 0 || gap > GAP_MAX_MINUTES) {
+        history_reset();
+    } else {
+        for (int64_t minute = 1; minute < gap; minute++) {
+            history_push(pushed_pressure + ((int64_t)pressure - pushed_pressure) * minute / gap);
+        }
+    }
+
+    history_push(pressure);
+    pushed_minute = bucket_minute;
+    pushed_pressure = pressure;
+}
+
+bool pressure_trend_update(int64_t uptime_ms, uint32_t pressure, uint32_t sea_level_pressure)
+{
+    int64_t minute = uptime_ms / MSEC_PER_SEC / SEC_PER_MIN;
+    bool changed = false;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (minute != bucket_minute) {
+        if (bucket_count > 0) {
+            bucket_close();
+        }
+        bucket_minute = minute;
+        bucket_sum = 0;
+        bucket_count = 0;
+    }
+    bucket_sum += pressure;
+    bucket_count++;
+
+    trend.slope_1h = window_slope(&windows[0]);
+    trend.slope_3h = window_slope(&windows[1]);
+    enum pressure_tendency tendency = tendency_classify(&windows[1], trend.slope_3h);
+    enum pressure_forecast forecast = forecast_classify(tendency, sea_level_pressure);
+
+    if (tendency != trend.tendency || forecast != trend.forecast) {
+        trend.tendency = tendency;
+        trend.forecast = forecast;
+        changed = true;
+    }
+
+    k_spin_unlock(&lock, key);
+
+    return changed;
+}
+
+void pressure_trend_get(struct pressure_trend *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = trend;
+    k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,65 @@
+#ifndef __PRESSURE_TREND_H__
+#define __PRESSURE_TREND_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Barometric tendency over 3 hours (Met Office thresholds)
+enum pressure_tendency {
+    PRESSURE_TENDENCY_UNKNOWN = 0,
+    // Less than 0.1 hPa
+    PRESSURE_TENDENCY_STEADY,
+    // 0.1 to 1.5 hPa
+    PRESSURE_TENDENCY_RISING_SLOWLY,
+    // 1.6 to 3.5 hPa
+    PRESSURE_TENDENCY_RISING,
+    // 3.6 to 6.0 hPa
+    PRESSURE_TENDENCY_RISING_QUICKLY,
+    // More than 6.0 hPa
+    PRESSURE_TENDENCY_RISING_VERY_RAPIDLY,
+    PRESSURE_TENDENCY_FALLING_SLOWLY,
+    PRESSURE_TENDENCY_FALLING,
+    PRESSURE_TENDENCY_FALLING_QUICKLY,
+    PRESSURE_TENDENCY_FALLING_VERY_RAPIDLY,
+};
+
+// Short-term forecast from the tendency and the sea level pressure
+enum pressure_forecast {
+    PRESSURE_FORECAST_UNKNOWN = 0,
+    PRESSURE_FORECAST_STORMY,
+    PRESSURE_FORECAST_RAIN,
+    PRESSURE_FORECAST_UNSETTLED,
+    PRESSURE_FORECAST_NO_CHANGE,
+    PRESSURE_FORECAST_IMPROVING,
+    PRESSURE_FORECAST_FAIR,
+};
+
+struct pressure_trend {
+    // Least squares slope over the last hour, in Pa per hour
+    int16_t slope_1h;
+    // Least squares slope over the last 3 hours, in Pa per hour
+    int16_t slope_3h;
+    enum pressure_tendency tendency;
+    enum pressure_forecast forecast;
+};
+
+/**
+ * @brief Add a pressure sample, averaged with the others of the same minute.
+ *
+ * The minutes without samples are interpolated, a longer gap restarts the estimation.
+ * Both windows are updated in constant time from running sums.
+ *
+ * @param[in] uptime_ms Sample time.
+ * @param[in] pressure Pressure in 0.1 Pa, for the slopes.
+ * @param[in] sea_level_pressure Sea level pressure in 0.1 Pa, for the forecast.
+ *
+ * @retval true if the tendency or the forecast changed.
+ */
+bool pressure_trend_update(int64_t uptime_ms, uint32_t pressure, uint32_t sea_level_pressure);
+
+/**
+ * @brief Get the latest trend.
+ */
+void pressure_trend_get(struct pressure_trend *trend);
+
+#endif  //__PRESSURE_TREND_H__
@@ -0,0 +1,16 @@
+#ifndef __TRACE_POINTS_H__
+#define __TRACE_POINTS_H__
+
+#include <zephyr/tracing/tracing.h>
+
+/*
+ * Application trace points, recorded as CTF named events next to the kernel ones (threads, work items,
+ * ISRs) when built with tracing.conf. The name is truncated to 20 characters by the CTF format.
+ */
+#if defined(CONFIG_TRACING_CTF)
+#define TRACE_POINT(name, arg0, arg1) sys_trace_named_event(name, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE_POINT(name, arg0, arg1)
+#endif
+
+#endif  //__TRACE_POINTS_H__
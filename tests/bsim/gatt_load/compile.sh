@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+# Builds the firmware (with stress.conf) and the simulated central for nrf52_bsim, see test_scripts/gatt_load.sh
+set -ue
+
+: "${ZEPHYR_BASE:?ZEPHYR_BASE must be set to point to the zephyr root directory}"
+
+source ${ZEPHYR_BASE}/tests/bsim/compile.source
+
+app_root=$(cd "$(dirname "${BASH_SOURCE[0]}")/../../.." && pwd)
+
+app=. conf_overlay=stress.conf exe_name=bs_${BOARD_TS}_xiao_sense_peripheral compile
+app=tests/bsim/gatt_load exe_name=bs_${BOARD_TS}_xiao_sense_gatt_load_central compile
+
+wait_for_background_jobs
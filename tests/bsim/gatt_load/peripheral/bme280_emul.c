@@ -0,0 +1,105 @@
+/*
+ * BME280 on the emulated I2C bus of the nrf52_bsim build (boards/nrf52_bsim.overlay), used by the
+ * BabbleSim load test. It exposes the register map of a sensor at rest: the bme280 driver probes,
+ * calibrates and fetches a constant sample of 25.08 C, 1006.53 hPa and 46.18 %RH.
+ */
+#define DT_DRV_COMPAT bosch_bme280
+
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#define BME280_EMUL_REG_CALIB_TP 0x88
+#define BME280_EMUL_REG_CALIB_H1 0xA1
+#define BME280_EMUL_REG_CHIP_ID 0xD0
+#define BME280_EMUL_REG_CALIB_H2 0xE1
+#define BME280_EMUL_REG_CTRL_HUM 0xF2
+#define BME280_EMUL_REG_CTRL_MEAS 0xF4
+#define BME280_EMUL_REG_CONFIG 0xF5
+#define BME280_EMUL_REG_DATA 0xF7
+
+#define BME280_EMUL_CHIP_ID 0x60
+#define BME280_EMUL_CALIB_H1 75
+
+// Temperature and pressure calibration words dig_T1..dig_T3, dig_P1..dig_P9 (datasheet example values)
+static const uint16_t calib_tp[] = {
+    27504, 26435, (uint16_t)-1000,
+    36477, (uint16_t)-10685, 3024, 2855, 140, (uint16_t)-7, 15500, (uint16_t)-14600, 6000,
+};
+
+// dig_H2 = 362, dig_H3 = 0, dig_H4 = 313, dig_H5 = 50, dig_H6 = 30 in the packed 0xE1..0xE7 layout
+static const uint8_t calib_h[] = {0x6A, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1E};
+
+// Raw pressure, temperature and humidity of the 0xF7..0xFE burst
+static const uint8_t raw_sample[] = {0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x6F, 0x00};
+
+struct bme280_emul_data {
+    uint8_t regs[256];
+    uint8_t reg;
+};
+
+static bool is_writable(uint8_t reg)
+{
+    return reg == BME280_EMUL_REG_CTRL_HUM || reg == BME280_EMUL_REG_CTRL_MEAS || reg == BME280_EMUL_REG_CONFIG;
+}
+
+// Writes are register address and value pairs, a lone address selects the start of the next read
+static int bme280_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs, int addr)
+{
+    struct bme280_emul_data *data = target->data;
+
+    ARG_UNUSED(addr);
+
+    for (int i = 0; i < num_msgs; i++) {
+        if (msgs[i].flags & I2C_MSG_READ) {
+            for (uint32_t j = 0; j < msgs[i].len; j++) {
+                msgs[i].buf[j] = data->regs[data->reg++];
+            }
+            continue;
+        }
+
+        uint32_t j = 0;
+        for (; j + 1 < msgs[i].len; j += 2) {
+            if (is_writable(msgs[i].buf[j])) {
+                data->regs[msgs[i].buf[j]] = msgs[i].buf[j + 1];
+            }
+        }
+        if (j < msgs[i].len) {
+            data->reg = msgs[i].buf[j];
+        }
+    }
+
+    return 0;
+}
+
+static const struct i2c_emul_api bme280_emul_api = {
+    .transfer = bme280_emul_transfer,
+};
+
+static int bme280_emul_init(const struct emul *target, const struct device *parent)
+{
+    struct bme280_emul_data *data = target->data;
+
+    ARG_UNUSED(parent);
+
+    data->regs[BME280_EMUL_REG_CHIP_ID] = BME280_EMUL_CHIP_ID;
+    for (size_t i = 0; i < ARRAY_SIZE(calib_tp); i++) {
+        sys_put_le16(calib_tp[i], &data->regs[BME280_EMUL_REG_CALIB_TP + i * sizeof(uint16_t)]);
+    }
+    data->regs[BME280_EMUL_REG_CALIB_H1] = BME280_EMUL_CALIB_H1;
+    memcpy(&data->regs[BME280_EMUL_REG_CALIB_H2], calib_h, sizeof(calib_h));
+    memcpy(&data->regs[BME280_EMUL_REG_DATA], raw_sample, sizeof(raw_sample));
+
+    return 0;
+}
+
+#define BME280_EMUL_DEFINE(inst)                                                                                       \
+    static struct bme280_emul_data bme280_emul_data_##inst;                                                            \
+    EMUL_DT_INST_DEFINE(inst, bme280_emul_init, &bme280_emul_data_##inst, NULL, &bme280_emul_api, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(BME280_EMUL_DEFINE)
@@ -0,0 +1,391 @@
+/*
+ * Simulated central of the BabbleSim load test. Every instance connects to the nrf52_bsim build of the
+ * firmware, pairs, then issues ESS temperature reads, AIOS Digital Output writes and ESS temperature CCC
+ * toggles for LOAD_DURATION_MS, and checks the p99 latencies, the throughput and the failure rate against
+ * the bounds below (the gate options of tools/gatt_load.py).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "babblekit/testcase.h"
+#include "bstests.h"
+
+#define PERIPHERAL_NAME "XIAO-SENSE"
+
+#define LOAD_DURATION_MS 20000
+// One operation per slot, a CCC toggle every CCC_TOGGLE_SLOTS slots, reads and writes alternate in the others
+#define SLOT_MS 50
+#define CCC_TOGGLE_SLOTS 20
+#define CONNECT_TIMEOUT_MS 30000
+#define SECURITY_TIMEOUT_MS 10000
+// An operation still pending after this long fails the test, its parameters can not be reused
+#define OPERATION_TIMEOUT_MS 2000
+
+#define MAX_P99_MS 150
+#define MIN_OPS_PER_SEC 18
+#define MAX_FAILED_PERMILLE 10
+
+// 15 ms, the update requested by the peripheral is declined so every run sees the same link
+#define CONN_INTERVAL 12
+#define CONN_SUPERVISION_TIMEOUT 400
+
+#define OPS_MAX (LOAD_DURATION_MS / SLOT_MS)
+
+enum op {
+    OP_READ,
+    OP_WRITE,
+    OP_CCC,
+    OP_COUNT,
+};
+
+static const char *const op_names[OP_COUNT] = {"read", "write", "ccc"};
+
+struct op_stats {
+    uint16_t latencies_ms[OPS_MAX];
+    size_t completed;
+    size_t failed;
+};
+
+static struct op_stats stats[OP_COUNT];
+
+static struct bt_conn *default_conn;
+static K_SEM_DEFINE(connected_sem, 0, 1);
+static K_SEM_DEFINE(security_sem, 0, 1);
+// Completion of the pending discovery, read, write or CCC write, op_err holds its ATT error
+static K_SEM_DEFINE(op_sem, 0, 1);
+static uint8_t op_err;
+static uint16_t discovered_handle;
+static atomic_t notifications = ATOMIC_INIT(0);
+
+static struct bt_gatt_read_params read_params;
+static struct bt_gatt_write_params write_params;
+static struct bt_gatt_subscribe_params subscribe_params;
+static struct bt_gatt_discover_params ccc_discover_params;
+static uint8_t digital_output_state;
+static bool is_subscribed;
+
+static void start_scan(void);
+
+static bool ad_has_name(struct bt_data *data, void *user_data)
+{
+    bool *found = user_data;
+
+    if (data->type == BT_DATA_NAME_COMPLETE && data->data_len == strlen(PERIPHERAL_NAME) &&
+        !memcmp(data->data, PERIPHERAL_NAME, data->data_len)) {
+        *found = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type, struct net_buf_simple *ad)
+{
+    bool found = false;
+
+    if (default_conn) {
+        return;
+    }
+
+    // The name is in the scan response
+    bt_data_parse(ad, ad_has_name, &found);
+    if (!found || bt_le_scan_stop()) {
+        return;
+    }
+
+    int err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+                                BT_LE_CONN_PARAM(CONN_INTERVAL, CONN_INTERVAL, 0, CONN_SUPERVISION_TIMEOUT),
+                                &default_conn);
+    if (err) {
+        TEST_FAIL("Failed to create the connection (err %d)", err);
+    }
+}
+
+static void start_scan(void)
+{
+    int err = bt_le_scan_start(BT_LE_SCAN_ACTIVE, device_found);
+    if (err) {
+        TEST_FAIL("Scanning failed to start (err %d)", err);
+    }
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+    if (conn != default_conn) {
+        return;
+    }
+
+    // Another central took the advertising event, try again on the next one
+    if (err) {
+        bt_conn_unref(default_conn);
+        default_conn = NULL;
+        start_scan();
+        return;
+    }
+
+    k_sem_give(&connected_sem);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (conn == default_conn) {
+        TEST_FAIL("Disconnected (reason 0x%02x)", reason);
+    }
+}
+
+static void security_changed(struct bt_conn *conn, bt_security_t level, enum bt_security_err err)
+{
+    if (err) {
+        TEST_FAIL("Pairing failed (err %d)", err);
+    }
+
+    k_sem_give(&security_sem);
+}
+
+static bool le_param_req(struct bt_conn *conn, struct bt_le_conn_param *param)
+{
+    return false;
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .security_changed = security_changed,
+    .le_param_req = le_param_req,
+};
+
+static uint8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             struct bt_gatt_discover_params *params)
+{
+    if (attr) {
+        const struct bt_gatt_chrc *chrc = attr->user_data;
+
+        discovered_handle = chrc->value_handle;
+    }
+
+    k_sem_give(&op_sem);
+    return BT_GATT_ITER_STOP;
+}
+
+static uint8_t read_func(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params, const void *data,
+                         uint16_t length)
+{
+    op_err = err;
+    k_sem_give(&op_sem);
+    return BT_GATT_ITER_STOP;
+}
+
+static void write_func(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+    op_err = err;
+    k_sem_give(&op_sem);
+}
+
+static void subscribe_func(struct bt_conn *conn, uint8_t err, struct bt_gatt_subscribe_params *params)
+{
+    op_err = err;
+    k_sem_give(&op_sem);
+}
+
+static uint8_t notify_func(struct bt_conn *conn, struct bt_gatt_subscribe_params *params, const void *data,
+                           uint16_t length)
+{
+    // No data once unsubscribed
+    if (data) {
+        atomic_inc(&notifications);
+    }
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+// The characteristic UUIDs used here are unique in the database of the firmware
+static uint16_t discover_characteristic(const struct bt_uuid *uuid)
+{
+    static struct bt_gatt_discover_params params;
+
+    params = (struct bt_gatt_discover_params){
+        .uuid = uuid,
+        .func = discover_func,
+        .start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE,
+        .end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE,
+        .type = BT_GATT_DISCOVER_CHARACTERISTIC,
+    };
+    discovered_handle = 0;
+
+    int err = bt_gatt_discover(default_conn, &params);
+    TEST_ASSERT(!err, "Discovery failed to start (err %d)", err);
+
+    err = k_sem_take(&op_sem, K_MSEC(OPERATION_TIMEOUT_MS));
+    TEST_ASSERT(!err, "Discovery timed out");
+    TEST_ASSERT(discovered_handle, "Characteristic not found");
+
+    return discovered_handle;
+}
+
+static int start_op(enum op op)
+{
+    switch (op) {
+    case OP_READ:
+        return bt_gatt_read(default_conn, &read_params);
+    case OP_WRITE:
+        digital_output_state = (digital_output_state + 1) & 0x07;
+        return bt_gatt_write(default_conn, &write_params);
+    default:
+        if (is_subscribed) {
+            return bt_gatt_unsubscribe(default_conn, &subscribe_params);
+        }
+        // The unsubscription clears the value
+        subscribe_params.value = BT_GATT_CCC_NOTIFY;
+        return bt_gatt_subscribe(default_conn, &subscribe_params);
+    }
+}
+
+static void run_op(enum op op)
+{
+    uint32_t started_at = k_uptime_get_32();
+
+    int err = start_op(op);
+    TEST_ASSERT(!err, "The %s failed to start (err %d)", op_names[op], err);
+
+    err = k_sem_take(&op_sem, K_MSEC(OPERATION_TIMEOUT_MS));
+    TEST_ASSERT(!err, "The %s timed out", op_names[op]);
+
+    if (op_err) {
+        stats[op].failed++;
+        return;
+    }
+
+    if (op == OP_CCC) {
+        is_subscribed = !is_subscribed;
+    }
+    stats[op].latencies_ms[stats[op].completed++] = MIN(k_uptime_get_32() - started_at, UINT16_MAX);
+}
+
+static int64_t run_load(void)
+{
+    int64_t started_at = k_uptime_get();
+    int64_t next_at = started_at;
+
+    for (uint32_t slot = 0; next_at < started_at + LOAD_DURATION_MS; slot++) {
+        if (slot % CCC_TOGGLE_SLOTS == 0) {
+            run_op(OP_CCC);
+        } else {
+            run_op(slot % 2 ? OP_READ : OP_WRITE);
+        }
+
+        next_at += SLOT_MS;
+        // Behind schedule: skip the missed slots instead of bursting to catch up
+        if (next_at < k_uptime_get()) {
+            next_at = k_uptime_get();
+        } else {
+            k_sleep(K_TIMEOUT_ABS_MS(next_at));
+        }
+    }
+
+    return k_uptime_get() - started_at;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+// Nearest-rank percentile, as in tools/gatt_load.py
+static uint16_t p99_ms(struct op_stats *op_stats)
+{
+    qsort(op_stats->latencies_ms, op_stats->completed, sizeof(op_stats->latencies_ms[0]), compare_latencies);
+    return op_stats->latencies_ms[DIV_ROUND_UP(op_stats->completed * 99, 100) - 1];
+}
+
+static void check_bounds(int64_t duration_ms)
+{
+    size_t completed = 0;
+    size_t failed = 0;
+
+    for (enum op op = 0; op < OP_COUNT; op++) {
+        TEST_ASSERT(stats[op].completed, "No %s completed", op_names[op]);
+
+        uint16_t p99 = p99_ms(&stats[op]);
+
+        printk("%s: completed %zu failed %zu p99 %u ms\n", op_names[op], stats[op].completed, stats[op].failed, p99);
+        TEST_ASSERT(p99 <= MAX_P99_MS, "The %s p99 %u ms > %u ms", op_names[op], p99, MAX_P99_MS);
+
+        completed += stats[op].completed;
+        failed += stats[op].failed;
+    }
+
+    uint32_t ops_per_sec = completed * MSEC_PER_SEC / duration_ms;
+
+    printk("%u ops/s, %zu failed, %ld notifications\n", ops_per_sec, failed, atomic_get(&notifications));
+    TEST_ASSERT(ops_per_sec >= MIN_OPS_PER_SEC, "Throughput %u ops/s < %u ops/s", ops_per_sec, MIN_OPS_PER_SEC);
+    TEST_ASSERT(failed * 1000 <= (completed + failed) * MAX_FAILED_PERMILLE, "%zu of %zu operations failed", failed,
+                completed + failed);
+}
+
+static void test_central_main(void)
+{
+    int err = bt_enable(NULL);
+    TEST_ASSERT(!err, "Bluetooth failed to start (err %d)", err);
+
+    start_scan();
+
+    err = k_sem_take(&connected_sem, K_MSEC(CONNECT_TIMEOUT_MS));
+    TEST_ASSERT(!err, "Not connected");
+
+    // The peripheral requests the encryption on every connection
+    err = k_sem_take(&security_sem, K_MSEC(SECURITY_TIMEOUT_MS));
+    TEST_ASSERT(!err, "The link was not encrypted");
+
+    uint16_t temperature_handle = discover_characteristic(BT_UUID_TEMPERATURE);
+    uint16_t digital_output_handle = discover_characteristic(BT_UUID_GATT_DO);
+
+    read_params.func = read_func;
+    read_params.handle_count = 1;
+    read_params.single.handle = temperature_handle;
+
+    write_params.func = write_func;
+    write_params.handle = digital_output_handle;
+    write_params.data = &digital_output_state;
+    write_params.length = sizeof(digital_output_state);
+
+    // The CCC handle is found on the first subscription
+    subscribe_params.subscribe = subscribe_func;
+    subscribe_params.notify = notify_func;
+    subscribe_params.value_handle = temperature_handle;
+    subscribe_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    subscribe_params.disc_params = &ccc_discover_params;
+
+    check_bounds(run_load());
+
+    TEST_PASS("GATT load within the bounds");
+}
+
+static const struct bst_test_instance test_defs[] = {
+    {
+        .test_id = "central",
+        .test_descr = "Connects to the firmware and runs the ESS read, AIOS write and CCC toggle load",
+        .test_main_f = test_central_main,
+    },
+    BSTEST_END_MARKER,
+};
+
+static struct bst_test_list *test_gatt_load_install(struct bst_test_list *tests)
+{
+    return bst_add_tests(tests, test_defs);
+}
+
+bst_test_install_t test_installers[] = {test_gatt_load_install, NULL};
+
+int main(void)
+{
+    bst_main();
+    return 0;
+}
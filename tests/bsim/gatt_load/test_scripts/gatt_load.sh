@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+# Three simulated centrals load the firmware at once, every one fails the run when its bounds are exceeded
+# (tests/bsim/gatt_load/src/main.c). Build first with tests/bsim/gatt_load/compile.sh.
+source ${ZEPHYR_BASE}/tests/bsim/sh_common.source
+
+simulation_id="xiao_sense_gatt_load"
+verbosity_level=2
+EXECUTE_TIMEOUT=300
+
+cd ${BSIM_OUT_PATH}/bin
+
+Execute ./bs_${BOARD_TS}_xiao_sense_peripheral \
+    -v=${verbosity_level} -s=${simulation_id} -d=0 -RealEncryption=1
+
+for device in 1 2 3; do
+    Execute ./bs_${BOARD_TS}_xiao_sense_gatt_load_central \
+        -v=${verbosity_level} -s=${simulation_id} -d=${device} -RealEncryption=1 -testid=central
+done
+
+Execute ./bs_2G4_phy_v1 -v=${verbosity_level} -s=${simulation_id} -D=4 -sim_length=60e6 $@
+
+wait_for_background_jobs
@@ -0,0 +1,79 @@
+#include <math.h>
+#include <zephyr/ztest.h>
+
+#include "derived_metrics.h"
+
+/*
+ * The integer metrics against the float formulas over the range documented in derived_metrics.h:
+ *
+ *     west twister -p native_sim -T tests/derived_metrics
+ */
+
+#define DEW_POINT_TOLERANCE 0.02
+#define ALTITUDE_TOLERANCE 0.02
+#define SEA_LEVEL_PRESSURE_TOLERANCE 0.2
+
+static double dew_point(double temperature, double humidity)
+{
+    double gamma = log(humidity / 100.0) + 17.62 * temperature / (243.12 + temperature);
+
+    return 243.12 * gamma / (17.62 - gamma);
+}
+
+static double pressure_altitude(double pressure)
+{
+    return 44330.77 * (1.0 - pow(pressure / 101325.0, 1.0 / 5.25588));
+}
+
+static double sea_level_pressure(double pressure, double elevation)
+{
+    return pressure * pow(1.0 - elevation / 44330.77, -5.25588);
+}
+
+ZTEST(derived_metrics, test_dew_point)
+{
+    for (int32_t temperature = -4000; temperature <= 8500; temperature += 7) {
+        for (uint32_t humidity = 100; humidity <= 10000; humidity += 13) {
+            double expected = dew_point(temperature / 100.0, humidity / 100.0);
+            double actual = derived_metrics_dew_point(temperature, humidity) / 100.0;
+
+            zassert_within(actual, expected, DEW_POINT_TOLERANCE, "T %d, RH %u: %f DegC, expected %f DegC",
+                           temperature, humidity, actual, expected);
+        }
+    }
+}
+
+ZTEST(derived_metrics, test_pressure_altitude)
+{
+    for (uint32_t pressure = 300000; pressure <= 1100000; pressure += 3) {
+        double expected = pressure_altitude(pressure / 10.0);
+        double actual = derived_metrics_pressure_altitude(pressure) / 100.0;
+
+        zassert_within(actual, expected, ALTITUDE_TOLERANCE, "p %u: %f m, expected %f m", pressure, actual,
+                       expected);
+    }
+}
+
+ZTEST(derived_metrics, test_sea_level_pressure)
+{
+    for (uint32_t pressure = 300000; pressure <= 1100000; pressure += 997) {
+        for (int32_t elevation = DERIVED_METRICS_ELEVATION_MIN; elevation <= DERIVED_METRICS_ELEVATION_MAX;
+             elevation += 311) {
+            double expected = sea_level_pressure(pressure / 10.0, elevation / 100.0);
+            double actual = derived_metrics_sea_level_pressure(pressure, elevation) / 10.0;
+
+            zassert_within(actual, expected, SEA_LEVEL_PRESSURE_TOLERANCE, "p %u, h %d: %f Pa, expected %f Pa",
+                           pressure, elevation, actual, expected);
+        }
+    }
+}
+
+ZTEST(derived_metrics, test_sea_level_pressure_clamps_elevation)
+{
+    zassert_equal(derived_metrics_sea_level_pressure(1013250, DERIVED_METRICS_ELEVATION_MAX + 1),
+                  derived_metrics_sea_level_pressure(1013250, DERIVED_METRICS_ELEVATION_MAX));
+    zassert_equal(derived_metrics_sea_level_pressure(1013250, DERIVED_METRICS_ELEVATION_MIN - 1),
+                  derived_metrics_sea_level_pressure(1013250, DERIVED_METRICS_ELEVATION_MIN));
+}
+
+ZTEST_SUITE(derived_metrics, NULL, NULL, NULL, NULL, NULL);
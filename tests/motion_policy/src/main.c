@@ -0,0 +1,60 @@
+#include <zephyr/ztest.h>
+
+#include "motion_policy.h"
+
+/*
+ * The moving / stationary decision of motion.c, without the IMU:
+ *
+ *     west twister -p native_sim -T tests/motion_policy
+ */
+
+static struct motion_policy policy;
+
+static void before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+    motion_policy_init(&policy);
+}
+
+ZTEST(motion_policy, test_starts_moving_fast)
+{
+    zassert_true(policy.is_moving);
+    zassert_equal(motion_policy_sampling_interval_ms(policy.is_moving), MOTION_POLICY_MOVING_SAMPLING_INTERVAL_MS);
+}
+
+ZTEST(motion_policy, test_stillness_timeout_slows_down)
+{
+    zassert_false(motion_policy_stillness_timeout(&policy, false), "the timeout must not restart");
+    zassert_false(policy.is_moving);
+    zassert_equal(motion_policy_sampling_interval_ms(policy.is_moving),
+                  MOTION_POLICY_STATIONARY_SAMPLING_INTERVAL_MS);
+}
+
+ZTEST(motion_policy, test_wake_up_speeds_up)
+{
+    motion_policy_stillness_timeout(&policy, false);
+
+    zassert_true(motion_policy_wake_up(&policy, true), "the timeout must restart");
+    zassert_true(policy.is_moving);
+    zassert_equal(motion_policy_sampling_interval_ms(policy.is_moving), MOTION_POLICY_MOVING_SAMPLING_INTERVAL_MS);
+}
+
+ZTEST(motion_policy, test_spurious_interrupt_is_ignored)
+{
+    motion_policy_stillness_timeout(&policy, false);
+
+    zassert_false(motion_policy_wake_up(&policy, false), "the timeout must not restart");
+    zassert_false(policy.is_moving);
+}
+
+ZTEST(motion_policy, test_latched_wake_up_keeps_moving)
+{
+    zassert_true(motion_policy_stillness_timeout(&policy, true), "the timeout must restart");
+    zassert_true(policy.is_moving);
+
+    // Once the device keeps still for a whole timeout it is stationary
+    zassert_false(motion_policy_stillness_timeout(&policy, false));
+    zassert_false(policy.is_moving);
+}
+
+ZTEST_SUITE(motion_policy, NULL, NULL, before, NULL, NULL);
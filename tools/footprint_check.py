@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Per-module RAM and flash footprint report, checked against footprint_budget.json.
+
+The sizes are summed from the input sections of the linker map file: every source file of the
+application is a module of its own, the other objects are grouped by their library. Initialized
+data counts for both the RAM and the flash (its load image).
+
+The budgets are kept per build configuration, the board target and the overlay confs of
+EXTRA_CONF_FILE (e.g. "xiao_ble_nrf52840_sense/default" or "xiao_ble_nrf52840_sense/stress"), since
+the overlays change the sizes.
+
+The check fails when a module or the whole image goes over its budget, when an application module
+has no budget yet, or when the configuration has no budgets at all (unless --allow-missing). Record the budgets of a configuration from its build with --update, and
+refresh them the same way after an intended change: the current sizes plus the margin of the budget
+file.
+
+    west build -t footprint_check
+    ./tools/footprint_check.py --map build/zephyr/zephyr.map --budget footprint_budget.json \\
+        --config xiao_ble_nrf52840_sense/default --update
+"""
+
+import argparse
+import json
+import re
+import sys
+from collections import defaultdict
+
+APP_LIBRARY = "libapp.a"
+
+MEMORY_REGION = re.compile(r"^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)", re.IGNORECASE)
+OUTPUT_SECTION = re.compile(r"^([^\s*]\S*)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(\s+load address 0x([0-9a-f]+))?")
+OUTPUT_SECTION_NAME = re.compile(r"^([^\s*]\S*)$")
+INPUT_SECTION = re.compile(r"^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+INPUT_SECTION_NAME = re.compile(r"^ (\S+)$")
+INPUT_SECTION_TAIL = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+ARCHIVE_MEMBER = re.compile(r"([^/\\]+)\.a\((.+?)\)$")
+
+
+def module_name(obj):
+    """Return the module of an object and whether it belongs to the application."""
+    match = ARCHIVE_MEMBER.search(obj)
+    if not match:
+        return obj.rsplit("/", 1)[-1], False
+    library, member = match.groups()
+    if library + ".a" == APP_LIBRARY:
+        return member.split(".")[0], True
+    return library, False
+
+
+def parse_regions(lines):
+    regions = {}
+    in_table = False
+    for line in lines:
+        if line.startswith("Memory Configuration"):
+            in_table = True
+            continue
+        if in_table and line.startswith("Linker script and memory map"):
+            break
+        match = MEMORY_REGION.match(line) if in_table else None
+        if match and match.group(1) != "*default*":
+            regions[match.group(1)] = (int(match.group(2), 16), int(match.group(3), 16))
+    return regions
+
+
+def region_kind(regions, address):
+    for name, (origin, length) in regions.items():
+        if origin <= address < origin + length:
+            if name.upper().startswith(("FLASH", "ROM")):
+                return "flash"
+            if name.upper().startswith(("RAM", "SRAM")):
+                return "ram"
+    return None
+
+
+def parse_map(path):
+    with open(path) as file:
+        lines = file.read().splitlines()
+
+    regions = parse_regions(lines)
+    sizes = defaultdict(lambda: {"flash": 0, "ram": 0})
+    app_modules = set()
+    started = False
+    loaded = False
+    pending_output = None
+    pending_input = None
+
+    def account(address, size, obj):
+        kind = region_kind(regions, address)
+        if kind is None or size == 0:
+            return
+        module, is_app = module_name(obj)
+        if is_app:
+            app_modules.add(module)
+        sizes[module][kind] += size
+        # The RAM copy of the initialized data is loaded from the flash
+        if kind == "ram" and loaded:
+            sizes[module]["flash"] += size
+
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            started = True
+            continue
+        if not started or not line.strip():
+            continue
+
+        if pending_output is not None:
+            match = re.match(r"^\s+0x[0-9a-f]+\s+0x[0-9a-f]+(\s+load address 0x[0-9a-f]+)?", line)
+            loaded = bool(match and match.group(1))
+            pending_output = None
+            continue
+        if pending_input is not None:
+            match = INPUT_SECTION_TAIL.match(line)
+            if match:
+                account(int(match.group(1), 16), int(match.group(2), 16), match.group(3))
+            pending_input = None
+            continue
+
+        match = OUTPUT_SECTION.match(line)
+        if match:
+            loaded = bool(match.group(4))
+            continue
+        if OUTPUT_SECTION_NAME.match(line) and not line.startswith(("LOAD", "OUTPUT", "START GROUP", "END GROUP")):
+            pending_output = line
+            continue
+
+        match = INPUT_SECTION.match(line)
+        if match and match.group(1).startswith("*"):
+            continue
+        if match:
+            account(int(match.group(2), 16), int(match.group(3), 16), match.group(4))
+            continue
+        match = INPUT_SECTION_NAME.match(line)
+        if match and not line.strip().startswith("*"):
+            pending_input = match.group(1)
+
+    return sizes, app_modules
+
+
+def totals(sizes):
+    return {kind: sum(size[kind] for size in sizes.values()) for kind in ("flash", "ram")}
+
+
+def with_margin(value, margin_percent):
+    return -(-value * (100 + margin_percent) // 100)
+
+
+def check(sizes, app_modules, budget):
+    failures = []
+    modules = budget.get("modules", {})
+
+    print(f"{'module':<28}{'flash':>10}{'budget':>10}{'ram':>10}{'budget':>10}")
+    for module in sorted(app_modules) + ["total"]:
+        size = totals(sizes) if module == "total" else sizes[module]
+        limits = budget.get("total") if module == "total" else modules.get(module)
+        if limits is None:
+            failures.append(f"{module} has no budget")
+            limits = {}
+        row = f"{module:<28}"
+        for kind in ("flash", "ram"):
+            limit = limits.get(kind)
+            mark = "!" if limit is not None and size[kind] > limit else " "
+            row += f"{size[kind]:>10}{(limit if limit is not None else '-'):>9}{mark}"
+            if mark == "!":
+                failures.append(f"{module} {kind} {size[kind]} B > {limit} B")
+        print(row)
+
+    return failures
+
+
+def update(sizes, app_modules, margin):
+    return {
+        "total": {kind: with_margin(size, margin) for kind, size in totals(sizes).items()},
+        "modules": {
+            module: {kind: with_margin(sizes[module][kind], margin) for kind in ("flash", "ram")}
+            for module in sorted(app_modules)
+        },
+    }
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--map", required=True, help="linker map file, build/zephyr/zephyr.map")
+    parser.add_argument("--budget", required=True, help="budget file")
+    parser.add_argument("--config", default="default", help="build configuration the budgets are kept for")
+    parser.add_argument("--update", action="store_true", help="set the module budgets to the current sizes")
+    parser.add_argument("--allow-missing", action="store_true", help="skip a configuration without budgets")
+    args = parser.parse_args()
+
+    sizes, app_modules = parse_map(args.map)
+    with open(args.budget) as file:
+        budget = json.load(file)
+
+    configurations = budget.setdefault("configurations", {})
+    if args.update:
+        configurations[args.config] = update(sizes, app_modules, budget.get("margin_percent", 10))
+        configurations = dict(sorted(configurations.items()))
+        budget["configurations"] = configurations
+        with open(args.budget, "w") as file:
+            json.dump(budget, file, indent=4)
+            file.write("\n")
+
+    if args.config not in configurations:
+        print(f"FOOTPRINT BUDGET MISSING: {args.config}, record it with --update", file=sys.stderr)
+        sys.exit(0 if args.allow_missing else 1)
+
+    failures = check(sizes, app_modules, configurations[args.config])
+    for failure in failures:
+        print(f"FOOTPRINT BUDGET EXCEEDED: {failure}", file=sys.stderr)
+    sys.exit(1 if failures else 0)
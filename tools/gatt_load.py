@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""GATT load generator for the AIOS and ESS services.
+
+Every --adapter runs its own central against the device, so N adapters give N simultaneous
+connections (the firmware accepts up to CONFIG_BT_MAX_CONN, see stress.conf). Each central issues
+ESS reads, AIOS Digital Output writes and ESS CCC toggles at the requested rates, and the
+aggregated throughput, latency percentiles and dropped operations are printed at the end.
+
+The gate options turn the run into a regression check: the script exits with status 1 when a
+threshold is exceeded. It needs the device and the adapters, tests/bsim/gatt_load is the simulated
+counterpart run as an automated gate.
+
+    pip install bleak
+    ./tools/gatt_load.py --adapter hci0 --adapter hci1 --duration 60 \\
+        --read-rate 20 --write-rate 20 --ccc-rate 1 --max-p99-ms 150 --max-drop-rate 0.01
+"""
+
+import argparse
+import asyncio
+import json
+import sys
+import time
+
+from bleak import BleakClient, BleakScanner
+from bleak.exc import BleakError
+
+DEVICE_NAME = "XIAO-SENSE"
+
+ESS_UUID = "0000181a-0000-1000-8000-00805f9b34fb"
+AIOS_UUID = "00001815-0000-1000-8000-00805f9b34fb"
+TEMPERATURE_UUID = "00002a6e-0000-1000-8000-00805f9b34fb"
+PRESSURE_UUID = "00002a6d-0000-1000-8000-00805f9b34fb"
+HUMIDITY_UUID = "00002a6f-0000-1000-8000-00805f9b34fb"
+DIGITAL_OUTPUT_UUID = "00002a57-0000-1000-8000-00805f9b34fb"
+
+# An operation still pending after this long is counted as dropped
+OPERATION_TIMEOUT_S = 2.0
+
+
+class Stats:
+    def __init__(self):
+        self.latencies = {"read": [], "write": [], "ccc": []}
+        self.failed = {"read": 0, "write": 0, "ccc": 0}
+        self.dropped = {"read": 0, "write": 0, "ccc": 0}
+        self.notifications = 0
+        self.disconnections = 0
+
+    def summary(self, duration):
+        result = {"duration_s": round(duration, 1), "notifications": self.notifications,
+                  "disconnections": self.disconnections, "ops": {}}
+        total = 0
+        issued = 0
+        for op, latencies in self.latencies.items():
+            latencies = sorted(latencies)
+            issued_op = len(latencies) + self.failed[op] + self.dropped[op]
+            total += len(latencies)
+            issued += issued_op
+            result["ops"][op] = {
+                "completed": len(latencies),
+                "failed": self.failed[op],
+                "dropped": self.dropped[op],
+                "ops_per_sec": round(len(latencies) / duration, 2),
+                "p50_ms": percentile(latencies, 50),
+                "p90_ms": percentile(latencies, 90),
+                "p99_ms": percentile(latencies, 99),
+                "max_ms": round(latencies[-1], 2) if latencies else None,
+            }
+        result["ops_per_sec"] = round(total / duration, 2)
+        result["drop_rate"] = round((issued - total) / issued, 4) if issued else 0.0
+        return result
+
+
+def percentile(values, percent):
+    if not values:
+        return None
+    index = min(len(values) - 1, max(0, -(-len(values) * percent // 100) - 1))
+    return round(values[index], 2)
+
+
+async def timed(stats, op, operation):
+    started_at = time.perf_counter()
+    try:
+        await asyncio.wait_for(operation, OPERATION_TIMEOUT_S)
+    except asyncio.TimeoutError:
+        stats.dropped[op] += 1
+        return
+    except BleakError:
+        stats.failed[op] += 1
+        return
+    stats.latencies[op].append((time.perf_counter() - started_at) * 1000)
+
+
+def find_characteristic(client, service_uuid, uuid):
+    # The sea level pressure shares its UUID with the measured one, the first match is the sensor value
+    for characteristic in client.services.get_service(service_uuid).characteristics:
+        if characteristic.uuid == uuid:
+            return characteristic
+    raise BleakError(f"Characteristic {uuid} not found")
+
+
+async def periodic(rate, deadline, action):
+    if rate <= 0:
+        return
+    period = 1.0 / rate
+    next_at = time.perf_counter()
+    while next_at < deadline:
+        await action()
+        next_at += period
+        delay = next_at - time.perf_counter()
+        # Behind schedule: skip the missed slots instead of bursting to catch up
+        if delay < 0:
+            next_at = time.perf_counter()
+        else:
+            await asyncio.sleep(delay)
+
+
+async def run_central(address, adapter, args, stats, deadline):
+    def disconnected(_client):
+        stats.disconnections += 1
+
+    def notified(_characteristic, _data):
+        stats.notifications += 1
+
+    async with BleakClient(address, adapter=adapter, disconnected_callback=disconnected) as client:
+        reads = [find_characteristic(client, ESS_UUID, uuid) for uuid in
+                 (TEMPERATURE_UUID, PRESSURE_UUID, HUMIDITY_UUID)]
+        digital_output = find_characteristic(client, AIOS_UUID, DIGITAL_OUTPUT_UUID)
+        read_index = 0
+        write_state = 0
+        subscribed = False
+
+        async def read():
+            nonlocal read_index
+            characteristic = reads[read_index % len(reads)]
+            read_index += 1
+            await timed(stats, "read", client.read_gatt_char(characteristic))
+
+        async def write():
+            nonlocal write_state
+            write_state = (write_state + 1) & 0x07
+            await timed(stats, "write", client.write_gatt_char(digital_output, bytes([write_state]), response=True))
+
+        async def toggle():
+            nonlocal subscribed
+            if subscribed:
+                await timed(stats, "ccc", client.stop_notify(reads[0]))
+            else:
+                await timed(stats, "ccc", client.start_notify(reads[0], notified))
+            subscribed = not subscribed
+
+        await asyncio.gather(periodic(args.read_rate, deadline, read), periodic(args.write_rate, deadline, write),
+                             periodic(args.ccc_rate, deadline, toggle))
+
+
+async def main(args):
+    address = args.address
+    if not address:
+        device = await BleakScanner.find_device_by_name(args.name, timeout=10.0)
+        if not device:
+            sys.exit(f"{args.name} not found")
+        address = device.address
+
+    stats = Stats()
+    adapters = args.adapter or [None]
+    started_at = time.perf_counter()
+    deadline = started_at + args.duration
+
+    results = await asyncio.gather(*(run_central(address, adapter, args, stats, deadline) for adapter in adapters),
+                                   return_exceptions=True)
+    for adapter, result in zip(adapters, results):
+        if isinstance(result, Exception):
+            print(f"Central on {adapter or 'default adapter'} failed: {result}", file=sys.stderr)
+
+    summary = stats.summary(time.perf_counter() - started_at)
+    summary["centrals"] = len(adapters)
+    return summary, any(isinstance(result, Exception) for result in results)
+
+
+def gate(summary, args):
+    failures = []
+    for op, op_summary in summary["ops"].items():
+        if args.max_p99_ms is not None and op_summary["p99_ms"] is not None and op_summary["p99_ms"] > args.max_p99_ms:
+            failures.append(f"{op} p99 {op_summary['p99_ms']} ms > {args.max_p99_ms} ms")
+    if args.min_ops_per_sec is not None and summary["ops_per_sec"] < args.min_ops_per_sec:
+        failures.append(f"throughput {summary['ops_per_sec']} ops/s < {args.min_ops_per_sec} ops/s")
+    if args.max_drop_rate is not None and summary["drop_rate"] > args.max_drop_rate:
+        failures.append(f"drop rate {summary['drop_rate']} > {args.max_drop_rate}")
+    return failures
+
+
+def print_summary(summary):
+    print(f"{summary['centrals']} central(s), {summary['duration_s']} s, {summary['ops_per_sec']} ops/s, "
+          f"drop rate {summary['drop_rate']}, {summary['notifications']} notifications, "
+          f"{summary['disconnections']} disconnections")
+    for op, op_summary in summary["ops"].items():
+        print(f"  {op:<5} completed {op_summary['completed']} failed {op_summary['failed']} "
+              f"dropped {op_summary['dropped']} {op_summary['ops_per_sec']} ops/s p50 {op_summary['p50_ms']} ms "
+              f"p90 {op_summary['p90_ms']} ms p99 {op_summary['p99_ms']} ms max {op_summary['max_ms']} ms")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--address", help="device address, scanned by name when omitted")
+    parser.add_argument("--name", default=DEVICE_NAME, help="device name to scan for")
+    parser.add_argument("--adapter", action="append", help="HCI adapter of a central, repeat for more connections")
+    parser.add_argument("--duration", type=float, default=30.0, help="run time in seconds")
+    parser.add_argument("--read-rate", type=float, default=10.0, help="ESS reads per second per central")
+    parser.add_argument("--write-rate", type=float, default=10.0, help="AIOS writes per second per central")
+    parser.add_argument("--ccc-rate", type=float, default=0.5, help="CCC toggles per second per central")
+    parser.add_argument("--json", help="write the results to this file")
+    parser.add_argument("--max-p99-ms", type=float, help="gate: maximum p99 latency of every operation")
+    parser.add_argument("--min-ops-per-sec", type=float, help="gate: minimum total throughput")
+    parser.add_argument("--max-drop-rate", type=float, help="gate: maximum share of failed and dropped operations")
+    args = parser.parse_args()
+
+    summary, central_failed = asyncio.run(main(args))
+    failures = gate(summary, args)
+    if central_failed:
+        failures.append("a central failed to connect or run")
+    summary["gate_failures"] = failures
+
+    print_summary(summary)
+    if args.json:
+        with open(args.json, "w") as file:
+            json.dump(summary, file, indent=2)
+
+    for failure in failures:
+        print(f"GATE FAILED: {failure}", file=sys.stderr)
+    sys.exit(1 if failures else 0)